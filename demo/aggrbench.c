@@ -0,0 +1,85 @@
+/*
+ *  aggrbench.c
+ *  TORC_Lite
+ *
+ *  Created by Panagiotis Hadjidoukas on 1/1/14.
+ *  Copyright 2014 ETH Zurich. All rights reserved.
+ *
+ */
+
+/* message rate of remote enqueues:
+ * a parameter sweep of tiny tasks spawned round-robin across the nodes.
+ * Run with TORC_AGGR_BYTES=0 to send every descriptor on its own.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <torc.h>
+
+#define DEF_NTASKS 100000
+
+void task(double *x, double *y)
+{
+    *y = 2.0 * (*x);
+}
+
+int main(int argc, char *argv[])
+{
+    int ntasks = DEF_NTASKS;
+
+    if (argc > 1)
+    {
+        ntasks = atoi(argv[1]);
+    }
+
+    torc_register_task(task);
+
+    torc_init(argc, argv);
+
+    double *x = (double *)malloc(ntasks * sizeof(double));
+    double *y = (double *)malloc(ntasks * sizeof(double));
+
+    for (int i = 0; i < ntasks; i++)
+    {
+        x[i] = i;
+        y[i] = -1;
+    }
+
+    int const nodes = torc_num_nodes();
+    int const workers = torc_i_num_workers();
+
+    double t0 = torc_gettime();
+
+    for (int i = 0; i < ntasks; i++)
+    {
+        torc_create((i % nodes) * workers, task, 2,
+                    1, MPI_DOUBLE, CALL_BY_COP,
+                    1, MPI_DOUBLE, CALL_BY_RES,
+                    &x[i], &y[i]);
+    }
+    double t1 = torc_gettime();
+
+    torc_waitall();
+
+    double t2 = torc_gettime();
+
+    int bad = 0;
+    for (int i = 0; i < ntasks; i++)
+    {
+        if (y[i] != 2.0 * i)
+        {
+            bad++;
+        }
+    }
+
+    char *s = getenv("TORC_AGGR_BYTES");
+
+    printf("nodes = %d, tasks = %d, TORC_AGGR_BYTES = %s\n", nodes, ntasks, (s != NULL) ? s : "default");
+    printf("spawn rate = %.3lf Mtasks/sec, completion rate = %.3lf Mtasks/sec, bad = %d\n",
+           ntasks / (t1 - t0) * 1.0E-6, ntasks / (t2 - t0) * 1.0E-6, bad);
+
+    free(x);
+    free(y);
+
+    torc_finalize();
+    return 0;
+}
@@ -0,0 +1,131 @@
+/*
+ *  bcastbench.c
+ *  TORC_Lite
+ *
+ *  Created by Panagiotis Hadjidoukas on 1/1/14.
+ *  Copyright 2014 ETH Zurich. All rights reserved.
+ *
+ */
+
+/* broadcast bandwidth:
+ * node 0 broadcasts a global buffer with torc_broadcast and torc_ibroadcast,
+ * then a task on every node checks the data it has received.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <torc.h>
+
+//! Largest buffer in doubles (64 MB)
+#define MAX_COUNT (8 * 1024 * 1024)
+
+#define DEF_MBYTES 16
+
+//! The buffer has the same address on all the nodes
+double data[MAX_COUNT];
+
+/**
+ * @brief Check the received buffer against the pattern of round r
+ *
+ */
+void check(long *count, int *r, int *bad)
+{
+    *bad = 0;
+    for (long i = 0; i < *count; i++)
+    {
+        if (data[i] != (double)(i + *r))
+        {
+            (*bad)++;
+        }
+    }
+}
+
+/**
+ * @brief A task on every node checks the buffer
+ * Direct tasks run on the server thread of their node and are never stolen
+ *
+ */
+int check_all(long count, int r)
+{
+    int const nodes = torc_num_nodes();
+    int const workers = torc_i_num_workers();
+
+    int bad[nodes];
+
+    for (int node = 0; node < nodes; node++)
+    {
+        torc_create_direct(node * workers, check, 3,
+                           1, MPI_LONG, CALL_BY_COP,
+                           1, MPI_INT, CALL_BY_COP,
+                           1, MPI_INT, CALL_BY_RES,
+                           &count, &r, &bad[node]);
+    }
+    torc_waitall();
+
+    int total = 0;
+    for (int node = 0; node < nodes; node++)
+    {
+        total += bad[node];
+    }
+
+    return total;
+}
+
+int main(int argc, char *argv[])
+{
+    long mbytes = DEF_MBYTES;
+
+    if (argc > 1)
+    {
+        mbytes = atol(argv[1]);
+    }
+
+    long count = mbytes * 1024 * 1024 / sizeof(double);
+    if (count > MAX_COUNT)
+    {
+        count = MAX_COUNT;
+    }
+
+    torc_register_task(check);
+
+    torc_init(argc, argv);
+
+    //! blocking broadcast
+    for (long i = 0; i < count; i++)
+    {
+        data[i] = i + 1;
+    }
+
+    double t0 = torc_gettime();
+    torc_broadcast(data, count, MPI_DOUBLE);
+    double t1 = torc_gettime();
+
+    int bad = check_all(count, 1);
+
+    printf("nodes = %d, %.1lf MB: torc_broadcast %.2lf ms (%.1lf MB/s), bad = %d\n", torc_num_nodes(),
+           count * sizeof(double) / 1048576.0, (t1 - t0) * 1.0E3, count * sizeof(double) / 1048576.0 / (t1 - t0), bad);
+
+    //! non-blocking broadcast, polled until complete
+    for (long i = 0; i < count; i++)
+    {
+        data[i] = i + 2;
+    }
+
+    t0 = torc_gettime();
+    torc_bcast_t handle = torc_ibroadcast(data, count, MPI_DOUBLE);
+    double t2 = torc_gettime();
+
+    long polls = 0;
+    while (!torc_ibroadcast_test(&handle))
+    {
+        polls++;
+    }
+    t1 = torc_gettime();
+
+    bad = check_all(count, 2);
+
+    printf("nodes = %d, %.1lf MB: torc_ibroadcast returned after %.3lf ms, complete after %.2lf ms (%ld polls), bad = %d\n",
+           torc_num_nodes(), count * sizeof(double) / 1048576.0, (t2 - t0) * 1.0E3, (t1 - t0) * 1.0E3, polls, bad);
+
+    torc_finalize();
+    return 0;
+}
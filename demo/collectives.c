@@ -0,0 +1,181 @@
+/*
+ *  collectives.c
+ *  TORC_Lite
+ *
+ *  Created by Panagiotis Hadjidoukas on 1/1/14.
+ *  Copyright 2014 ETH Zurich. All rights reserved.
+ *
+ */
+
+/* reductions and gathers of per-node results:
+ * a task on every node fills the partial results of its node, then node 0
+ * combines them with torc_reduce, torc_allreduce and torc_gather while the
+ * workers run a batch of unrelated tasks.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <torc.h>
+
+#define N 1000
+
+//! Per-node results, at the same address on all the nodes
+double partial[N];
+double total[N];
+long nodeid[2];
+double loc[2];
+
+/**
+ * @brief Fill the results of this node (a direct task, run by the server thread of the node)
+ *
+ */
+void fill(void)
+{
+    int const me = torc_node_id();
+
+    for (int i = 0; i < N; i++)
+    {
+        partial[i] = me + i;
+    }
+    nodeid[0] = me;
+    nodeid[1] = me * me;
+
+    //! value and position of the largest value of the node
+    loc[0] = (me * 7) % 5;
+    loc[1] = me;
+}
+
+/**
+ * @brief Check the result of torc_allreduce on this node
+ *
+ */
+void check(int *bad)
+{
+    int const nodes = torc_num_nodes();
+
+    *bad = 0;
+    for (int i = 0; i < N; i++)
+    {
+        if (total[i] != (double)(nodes - 1 + i))
+        {
+            (*bad)++;
+        }
+    }
+}
+
+/**
+ * @brief User-defined combiner: largest value and its position, on pairs of doubles
+ *
+ */
+void maxloc(void *inout, void const *in, long count, MPI_Datatype dtype)
+{
+    double *a = (double *)inout;
+    double const *b = (double const *)in;
+
+    for (long i = 0; i < count; i += 2)
+    {
+        if ((b[i] > a[i]) || ((b[i] == a[i]) && (b[i + 1] < a[i + 1])))
+        {
+            a[i] = b[i];
+            a[i + 1] = b[i + 1];
+        }
+    }
+}
+
+/**
+ * @brief Background work
+ *
+ */
+void work(void)
+{
+    usleep(1000);
+}
+
+int main(int argc, char *argv[])
+{
+    torc_register_task(fill);
+    torc_register_task(check);
+    torc_register_task(maxloc);
+    torc_register_task(work);
+
+    torc_init(argc, argv);
+
+    int const nodes = torc_num_nodes();
+    int const workers = torc_i_num_workers();
+
+    for (int node = 0; node < nodes; node++)
+    {
+        torc_create_direct(node * workers, fill, 0);
+    }
+    torc_waitall();
+
+    //! the workers keep running tasks during the collectives
+    for (int i = 0; i < 4 * torc_num_workers(); i++)
+    {
+        torc_create(-1, work, 0);
+    }
+
+    double t0 = torc_gettime();
+
+    double sum[N];
+    torc_reduce(partial, sum, N, MPI_DOUBLE, TORC_SUM);
+
+    double t1 = torc_gettime();
+
+    int bad = 0;
+    for (int i = 0; i < N; i++)
+    {
+        //! sum over the nodes of (node + i)
+        if (sum[i] != (double)(nodes * (nodes - 1) / 2 + nodes * i))
+        {
+            bad++;
+        }
+    }
+    printf("torc_reduce(SUM)     %.3lf ms, bad = %d\n", (t1 - t0) * 1.0E3, bad);
+
+    long maxid[2];
+    torc_reduce(nodeid, maxid, 2, MPI_LONG, TORC_MAX);
+    printf("torc_reduce(MAX)     %ld %ld (expected %d %d)\n", maxid[0], maxid[1], nodes - 1, (nodes - 1) * (nodes - 1));
+
+    double best[2];
+    torc_reduce(loc, best, 2, MPI_DOUBLE, maxloc);
+    printf("torc_reduce(maxloc)  %.0lf at node %.0lf\n", best[0], best[1]);
+
+    t0 = torc_gettime();
+    torc_allreduce(partial, total, N, MPI_DOUBLE, TORC_MAX);
+    t1 = torc_gettime();
+
+    int bads[nodes];
+    for (int node = 0; node < nodes; node++)
+    {
+        torc_create_direct(node * workers, check, 1,
+                           1, MPI_INT, CALL_BY_RES,
+                           &bads[node]);
+    }
+    torc_waitall();
+
+    bad = 0;
+    for (int node = 0; node < nodes; node++)
+    {
+        bad += bads[node];
+    }
+    printf("torc_allreduce(MAX)  %.3lf ms, bad = %d\n", (t1 - t0) * 1.0E3, bad);
+
+    long ids[2 * nodes];
+    torc_gather(nodeid, ids, 2, MPI_LONG);
+
+    bad = 0;
+    for (int node = 0; node < nodes; node++)
+    {
+        if ((ids[2 * node] != node) || (ids[2 * node + 1] != node * node))
+        {
+            bad++;
+        }
+    }
+    printf("torc_gather          bad = %d\n", bad);
+
+    torc_waitall();
+
+    torc_finalize();
+    return 0;
+}
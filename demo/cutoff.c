@@ -0,0 +1,161 @@
+/*
+ *  cutoff.c
+ *  TORC_Lite
+ *
+ *  Created by Panagiotis Hadjidoukas on 1/1/14.
+ *  Copyright 2014 ETH Zurich. All rights reserved.
+ *
+ */
+
+/* work-first cut-off:
+ * a recursive Fibonacci that creates a task for every call. The first run
+ * uses the cut-offs of the environment (TORC_CUTOFF_LEVEL,
+ * TORC_THROTTLING_FACTOR), the second one the application hint: the calls
+ * for n below a threshold are executed inline by their creator. Finally,
+ * with the hint set, a task is placed on every worker of the node: the hint
+ * does not override the placement, each task runs on the worker it was
+ * placed on.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sched.h>
+#include <torc.h>
+
+#define DEF_FIB_NUM 24
+#define DEF_HINT_NUM 16
+
+static int hint_num = -1;
+
+//! Worker that executed the task placed on each worker of the node
+static int *ran;
+
+void fib(long *pn, long *res)
+{
+    long const n = *pn;
+
+    if (n < 2)
+    {
+        *res = n;
+        return;
+    }
+
+    long n_1 = n - 1;
+    long n_2 = n - 2;
+    long res1 = 0;
+    long res2 = 0;
+
+    if (hint_num >= 0)
+    {
+        torc_set_inline(n <= hint_num);
+    }
+
+    torc_create(-1, fib, 2,
+                1, MPI_LONG, CALL_BY_COP,
+                1, MPI_LONG, CALL_BY_RES,
+                &n_1, &res1);
+    torc_create(-1, fib, 2,
+                1, MPI_LONG, CALL_BY_COP,
+                1, MPI_LONG, CALL_BY_RES,
+                &n_2, &res2);
+
+    torc_waitall();
+
+    *res = res1 + res2;
+}
+
+/**
+ * @brief Report the worker that executes the task placed on worker w
+ * The task keeps its worker busy until the other workers have woken up and
+ * picked up their own tasks
+ *
+ */
+void where(int *w)
+{
+    usleep(10000);
+    __atomic_store_n(&ran[*w], torc_i_worker_id(), __ATOMIC_RELEASE);
+}
+
+double run(long n, long *res)
+{
+    double t0 = torc_gettime();
+    fib(&n, res);
+    return torc_gettime() - t0;
+}
+
+int main(int argc, char *argv[])
+{
+    long n = DEF_FIB_NUM;
+    int hint = DEF_HINT_NUM;
+
+    if (argc > 1)
+    {
+        n = atol(argv[1]);
+    }
+    if (argc > 2)
+    {
+        hint = atoi(argv[2]);
+    }
+
+    torc_register_task(fib);
+    torc_register_task(where);
+
+    torc_init(argc, argv);
+
+    long r1, r2;
+
+    double const t1 = run(n, &r1);
+
+    //! the hint is a per-worker flag, every call sets it before creating its tasks
+    hint_num = hint;
+    double const t2 = run(n, &r2);
+    hint_num = -1;
+
+    //! placed tasks are not run inline, node 0 hosts workers 0 to nworkers-1
+    int const nworkers = torc_i_num_workers();
+    ran = (int *)malloc(nworkers * sizeof(int));
+
+    torc_set_inline(1);
+    for (int w = 0; w < nworkers; w++)
+    {
+        ran[w] = -1;
+        torc_create(w, where, 1,
+                    1, MPI_INT, CALL_BY_COP,
+                    &w);
+    }
+    torc_set_inline(0);
+
+    //! the creator does not wait in the scheduler, where it would take the placed tasks itself
+    for (int w = 0; w < nworkers; w++)
+    {
+        while (__atomic_load_n(&ran[w], __ATOMIC_ACQUIRE) < 0)
+        {
+            sched_yield();
+        }
+    }
+    torc_waitall();
+
+    int misplaced = 0;
+    for (int w = 0; w < nworkers; w++)
+    {
+        misplaced += (ran[w] != w);
+    }
+
+    long a = 0, b = 1;
+    for (long i = 0; i < n; i++)
+    {
+        long const c = a + b;
+        a = b;
+        b = c;
+    }
+
+    printf("fib(%ld) = %ld\n", n, r1);
+    printf("environment cut-off = %.2lf ms, hint below %d = %.2lf ms, bad = %d\n", t1 * 1.0E3, hint, t2 * 1.0E3,
+           (r1 != a) + (r2 != a));
+    printf("hint set, tasks placed on %d workers, misplaced = %d\n", nworkers, misplaced);
+
+    free(ran);
+
+    torc_finalize();
+    return 0;
+}
@@ -0,0 +1,212 @@
+/*
+ *  dataflow.c
+ *  TORC_Lite
+ *
+ *  Created by Panagiotis Hadjidoukas on 1/1/14.
+ *  Copyright 2014 ETH Zurich. All rights reserved.
+ *
+ */
+
+/* dataflow mode:
+ * a periodic 1D three-point stencil over nblocks blocks, swept nsteps times.
+ * Each task updates one block from its block and the two neighbouring cells
+ * of the previous sweep. The sweeps are separated either by torc_waitall or
+ * only by the data dependencies of the tasks (torc_enable_dataflow).
+ * The tasks sleep for a block dependent time to model load imbalance.
+ * The inputs are passed by pointer, so that the tasks read the output of the
+ * previous sweep; values passed by copy are taken when a task is created.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <torc.h>
+
+#define DEF_NBLOCKS 16
+#define DEF_NSTEPS 8
+#define BS 64
+
+void step(double *left, double *in, double *right, double *out, int *b)
+{
+    for (int i = 0; i < BS; i++)
+    {
+        double const l = (i == 0) ? *left : in[i - 1];
+        double const r = (i == BS - 1) ? *right : in[i + 1];
+        out[i] = (l + in[i] + r) / 3.0;
+    }
+
+    //! some blocks are slower than others
+    usleep(1000 * (1 + (*b % 4)));
+}
+
+/**
+ * @brief Append the value of i to the log, whose first element counts the entries
+ *
+ */
+void record(int *i, int *log)
+{
+    log[1 + log[0]] = *i;
+    log[0]++;
+}
+
+/**
+ * @brief Tasks ordered through the log get the loop index by copy: each one
+ * must see the value it was created with, although it runs later
+ *
+ * @return int number of wrong entries
+ */
+int byvalue(int ntasks, int *log)
+{
+    log[0] = 0;
+
+    torc_enable_dataflow();
+    for (int i = 0; i < ntasks; i++)
+    {
+        torc_create(-1, record, 2,
+                    1, MPI_INT, CALL_BY_COP,
+                    ntasks + 1, MPI_INT, CALL_BY_REF,
+                    &i, log);
+    }
+    torc_waitall();
+    torc_disable_dataflow();
+
+    int bad = (log[0] != ntasks);
+    for (int i = 0; i < log[0]; i++)
+    {
+        bad += (log[1 + i] != i);
+    }
+
+    return bad;
+}
+
+/**
+ * @brief Run nsteps sweeps, return the elapsed time
+ *
+ */
+double sweep(double *u[2], int nblocks, int nsteps, int df, int *blk)
+{
+    if (df)
+    {
+        torc_enable_dataflow();
+    }
+
+    double t0 = torc_gettime();
+
+    for (int t = 0; t < nsteps; t++)
+    {
+        double *in = u[t % 2];
+        double *out = u[(t + 1) % 2];
+
+        for (int b = 0; b < nblocks; b++)
+        {
+            int const l = (b == 0) ? nblocks * BS - 1 : b * BS - 1;
+            int const r = (b == nblocks - 1) ? 0 : (b + 1) * BS;
+
+            torc_create(-1, step, 5,
+                        1, MPI_DOUBLE, CALL_BY_PTR,
+                        BS, MPI_DOUBLE, CALL_BY_PTR,
+                        1, MPI_DOUBLE, CALL_BY_PTR,
+                        BS, MPI_DOUBLE, CALL_BY_RES,
+                        1, MPI_INT, CALL_BY_COP,
+                        &in[l], &in[b * BS], &in[r], &out[b * BS], &blk[b]);
+        }
+
+        if (!df)
+        {
+            torc_waitall();
+        }
+    }
+    torc_waitall();
+
+    double t1 = torc_gettime();
+
+    if (df)
+    {
+        torc_disable_dataflow();
+    }
+
+    return t1 - t0;
+}
+
+int main(int argc, char *argv[])
+{
+    int nblocks = DEF_NBLOCKS;
+    int nsteps = DEF_NSTEPS;
+
+    if (argc > 1)
+    {
+        nblocks = atoi(argv[1]);
+    }
+    if (argc > 2)
+    {
+        nsteps = atoi(argv[2]);
+    }
+
+    torc_register_task(step);
+    torc_register_task(record);
+
+    torc_init(argc, argv);
+
+    int const n = nblocks * BS;
+
+    double *ref = (double *)malloc(2 * n * sizeof(double));
+    double *u[2] = {(double *)malloc(n * sizeof(double)), (double *)malloc(n * sizeof(double))};
+    double *v[2] = {(double *)malloc(n * sizeof(double)), (double *)malloc(n * sizeof(double))};
+    int *blk = (int *)malloc(nblocks * sizeof(int));
+
+    for (int b = 0; b < nblocks; b++)
+    {
+        blk[b] = b;
+    }
+
+    //! serial reference
+    for (int i = 0; i < n; i++)
+    {
+        ref[i] = u[0][i] = v[0][i] = (double)(i % 17);
+    }
+    for (int t = 0; t < nsteps; t++)
+    {
+        double *in = ref + (t % 2) * n;
+        double *out = ref + ((t + 1) % 2) * n;
+        for (int i = 0; i < n; i++)
+        {
+            out[i] = (in[(i + n - 1) % n] + in[i] + in[(i + 1) % n]) / 3.0;
+        }
+    }
+
+    double const tb = sweep(u, nblocks, nsteps, 0, blk);
+    double const td = sweep(v, nblocks, nsteps, 1, blk);
+
+    double const *r = ref + (nsteps % 2) * n;
+    int bad = 0;
+    for (int i = 0; i < n; i++)
+    {
+        if ((u[nsteps % 2][i] != r[i]) || (v[nsteps % 2][i] != r[i]))
+        {
+            bad++;
+        }
+    }
+
+    printf("blocks = %d, steps = %d\n", nblocks, nsteps);
+    printf("barriers = %.2lf ms, dataflow = %.2lf ms, bad = %d\n", tb * 1.0E3, td * 1.0E3, bad);
+
+    int *log = (int *)malloc((nblocks + 1) * sizeof(int));
+    bad = byvalue(nblocks, log);
+    printf("by value:");
+    for (int i = 0; i < log[0]; i++)
+    {
+        printf(" %d", log[1 + i]);
+    }
+    printf(", bad = %d\n", bad);
+    free(log);
+
+    free(ref);
+    free(u[0]);
+    free(u[1]);
+    free(v[0]);
+    free(v[1]);
+    free(blk);
+
+    torc_finalize();
+    return 0;
+}
@@ -0,0 +1,108 @@
+/*
+ *  descbench.c
+ *  TORC_Lite
+ *
+ *  Created by Panagiotis Hadjidoukas on 1/1/14.
+ *  Copyright 2014 ETH Zurich. All rights reserved.
+ *
+ */
+
+/* descriptor footprint and spawn rate:
+ * spawns batches of empty tasks with 1, 4 and 8 arguments and reports the
+ * bytes per task (pooled descriptor and wire size) and the tasks per second
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <torc_internal.h>
+#include <torc.h>
+
+#define DEF_NTASKS 200000
+
+void task1(int *a)
+{
+}
+
+void task4(int *a, int *b, int *c, int *d)
+{
+}
+
+void task8(int *a, int *b, int *c, int *d, int *e, int *f, int *g, int *h)
+{
+}
+
+#ifdef TORC_DESC_SIZE
+#define POOL_BYTES(narg) _torc_desc_pool_size(narg)
+#define WIRE_BYTES(narg) TORC_DESC_SIZE(narg)
+#else
+//! fixed-size descriptors
+#define POOL_BYTES(narg) sizeof(torc_t)
+#define WIRE_BYTES(narg) sizeof(torc_t)
+#endif
+
+int main(int argc, char *argv[])
+{
+    int ntasks = DEF_NTASKS;
+
+    if (argc > 1)
+    {
+        ntasks = atoi(argv[1]);
+    }
+
+    torc_register_task(task1);
+    torc_register_task(task4);
+    torc_register_task(task8);
+
+    torc_init(argc, argv);
+
+    int v = 1;
+
+    int const nargs[] = {1, 4, 8};
+
+    printf("tasks = %d\n", ntasks);
+    for (int k = 0; k < 3; k++)
+    {
+        int const narg = nargs[k];
+
+        double const t0 = torc_gettime();
+        for (int i = 0; i < ntasks; i++)
+        {
+            switch (narg)
+            {
+            case 1:
+                torc_create(-1, task1, 1,
+                            1, MPI_INT, CALL_BY_COP,
+                            &v);
+                break;
+            case 4:
+                torc_create(-1, task4, 4,
+                            1, MPI_INT, CALL_BY_COP,
+                            1, MPI_INT, CALL_BY_COP,
+                            1, MPI_INT, CALL_BY_COP,
+                            1, MPI_INT, CALL_BY_COP,
+                            &v, &v, &v, &v);
+                break;
+            default:
+                torc_create(-1, task8, 8,
+                            1, MPI_INT, CALL_BY_COP,
+                            1, MPI_INT, CALL_BY_COP,
+                            1, MPI_INT, CALL_BY_COP,
+                            1, MPI_INT, CALL_BY_COP,
+                            1, MPI_INT, CALL_BY_COP,
+                            1, MPI_INT, CALL_BY_COP,
+                            1, MPI_INT, CALL_BY_COP,
+                            1, MPI_INT, CALL_BY_COP,
+                            &v, &v, &v, &v, &v, &v, &v, &v);
+                break;
+            }
+        }
+        torc_waitall();
+        double const t1 = torc_gettime();
+
+        printf("narg = %d: %5ld bytes/task (pool), %5ld bytes/task (wire), %8.3lf Mtasks/sec\n",
+               narg, (long)POOL_BYTES(narg), (long)WIRE_BYTES(narg), ntasks / (t1 - t0) * 1.0E-6);
+        fflush(0);
+    }
+
+    torc_finalize();
+    return 0;
+}
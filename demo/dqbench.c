@@ -0,0 +1,230 @@
+/*
+ *  dqbench.c
+ *  TORC_Lite
+ *
+ *  Created by Panagiotis Hadjidoukas on 1/1/14.
+ *  Copyright 2014 ETH Zurich. All rights reserved.
+ *
+ */
+
+/* spawn/steal throughput of the ready queues:
+ * old: ten shared, lock-protected level queues (public_grq[10])
+ * new: per-worker lock-free work-stealing deques
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <torc_internal.h>
+#include <torc.h>
+
+#define DEF_NTHREADS 4
+#define DEF_NITEMS 1000000
+#define NLEVELS 10
+
+typedef struct item
+{
+    QUEUE_NODE_FIELDS(struct item)
+    int level;
+} item_t;
+
+QUEUE_DEFINE(item_t, item_queue_t);
+
+static int nthreads = DEF_NTHREADS;
+static long nitems = DEF_NITEMS;
+
+//! old queues
+static item_queue_t levelq[NLEVELS];
+
+//! new queues
+static deque_t wsq[MAX_NVPS];
+
+static item_t *items;
+
+static pthread_barrier_t bar;
+
+static atomic_long consumed;
+
+static void old_push(int me, item_t *e)
+{
+    _enqueue_tail(&levelq[e->level], e);
+}
+
+static item_t *old_pop(int me)
+{
+    item_t *e = NULL;
+    for (int i = NLEVELS - 1; i >= 0; i--)
+    {
+        _dequeue(&levelq[i], &e);
+        if (e != NULL)
+        {
+            break;
+        }
+    }
+    return e;
+}
+
+static void new_push(int me, item_t *e)
+{
+    _deque_push(&wsq[me], e);
+}
+
+static item_t *new_pop(int me)
+{
+    item_t *e = (item_t *)_deque_pop(&wsq[me]);
+    if (e != NULL)
+    {
+        return e;
+    }
+
+    for (int k = 1; k < nthreads; k++)
+    {
+        int const victim = (me + k) % nthreads;
+        do
+        {
+            e = (item_t *)_deque_steal(&wsq[victim]);
+        } while (e == DEQUE_ABORT);
+
+        if (e != NULL)
+        {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+struct bench
+{
+    const char *name;
+    void (*push)(int, item_t *);
+    item_t *(*pop)(int);
+    //! 1: every thread spawns its own items, 0: thread 0 spawns, the rest steal
+    int all_spawn;
+};
+
+static void *bench_thread(void *arg)
+{
+    struct bench *b = (struct bench *)((void **)arg)[0];
+    int const me = (int)(long)((void **)arg)[1];
+
+    pthread_barrier_wait(&bar);
+
+    if (b->all_spawn || (me == 0))
+    {
+        long const per = b->all_spawn ? nitems / nthreads : nitems;
+        item_t *mine = b->all_spawn ? &items[me * per] : items;
+
+        //! spawn in bursts of 16 and consume in between, like recursive tasks
+        for (long i = 0; i < per; i += 16)
+        {
+            long const n = (per - i < 16) ? per - i : 16;
+            for (long j = 0; j < n; j++)
+            {
+                b->push(me, &mine[i + j]);
+            }
+            if (b->all_spawn)
+            {
+                for (long j = 0; j < n; j++)
+                {
+                    if (b->pop(me) != NULL)
+                    {
+                        atomic_fetch_add(&consumed, 1);
+                    }
+                }
+            }
+        }
+    }
+
+    while (atomic_load(&consumed) < nitems)
+    {
+        if (b->pop(me) != NULL)
+        {
+            atomic_fetch_add(&consumed, 1);
+        }
+    }
+
+    return NULL;
+}
+
+static double run(struct bench *b)
+{
+    pthread_t th[MAX_NVPS];
+    void *args[MAX_NVPS][2];
+
+    for (int i = 0; i < NLEVELS; i++)
+    {
+        _queue_init(&levelq[i]);
+    }
+    for (int i = 0; i < nthreads; i++)
+    {
+        _deque_init(&wsq[i]);
+    }
+    atomic_store(&consumed, 0);
+
+    pthread_barrier_init(&bar, NULL, nthreads + 1);
+    for (int i = 0; i < nthreads; i++)
+    {
+        args[i][0] = b;
+        args[i][1] = (void *)(long)i;
+        pthread_create(&th[i], NULL, bench_thread, args[i]);
+    }
+
+    double const t0 = torc_gettime();
+    pthread_barrier_wait(&bar);
+    for (int i = 0; i < nthreads; i++)
+    {
+        pthread_join(th[i], NULL);
+    }
+    double const t1 = torc_gettime();
+
+    pthread_barrier_destroy(&bar);
+    for (int i = 0; i < nthreads; i++)
+    {
+        _deque_destroy(&wsq[i]);
+    }
+    for (int i = 0; i < NLEVELS; i++)
+    {
+        _queue_destroy(&levelq[i]);
+    }
+
+    return t1 - t0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1)
+    {
+        nthreads = atoi(argv[1]);
+    }
+    if (argc > 2)
+    {
+        nitems = atol(argv[2]);
+    }
+    if ((nthreads < 1) || (nthreads > MAX_NVPS))
+    {
+        nthreads = DEF_NTHREADS;
+    }
+
+    items = (item_t *)calloc(nitems, sizeof(item_t));
+    for (long i = 0; i < nitems; i++)
+    {
+        items[i].level = i % NLEVELS;
+    }
+
+    struct bench benches[] = {
+        {"spawn/pop (old)", old_push, old_pop, 1},
+        {"spawn/pop (new)", new_push, new_pop, 1},
+        {"steal     (old)", old_push, old_pop, 0},
+        {"steal     (new)", new_push, new_pop, 0},
+    };
+
+    printf("threads = %d, items = %ld\n", nthreads, nitems);
+    for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++)
+    {
+        double const t = run(&benches[i]);
+        printf("%s: %8.3lf secs, %10.3lf Mtasks/sec\n", benches[i].name, t, nitems / t * 1.0E-6);
+        fflush(0);
+    }
+
+    free(items);
+    return 0;
+}
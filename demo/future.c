@@ -0,0 +1,112 @@
+/*
+ *  future.c
+ *  TORC_Lite
+ *
+ *  Created by Panagiotis Hadjidoukas on 1/1/14.
+ *  Copyright 2014 ETH Zurich. All rights reserved.
+ *
+ */
+
+/* futures:
+ * tasks of different durations are spread across the workers of all nodes and
+ * their results are consumed in completion order with torc_test, instead of
+ * waiting for all of them with torc_waitall.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <torc.h>
+
+#define DEF_NTASKS 16
+#define DEF_TASK_MS 10
+
+void task(int *ms, double *y)
+{
+    usleep(*ms * 1000);
+    *y = 2.0 * (*ms);
+}
+
+int main(int argc, char *argv[])
+{
+    int ntasks = DEF_NTASKS;
+    int ms = DEF_TASK_MS;
+
+    if (argc > 1)
+    {
+        ntasks = atoi(argv[1]);
+    }
+    if (argc > 2)
+    {
+        ms = atoi(argv[2]);
+    }
+
+    torc_register_task(task);
+
+    torc_init(argc, argv);
+
+    int *t = (int *)malloc(ntasks * sizeof(int));
+    double *y = (double *)malloc(ntasks * sizeof(double));
+    torc_handle_t *h = (torc_handle_t *)malloc(ntasks * sizeof(torc_handle_t));
+
+    double t0 = torc_gettime();
+
+    for (int i = 0; i < ntasks; i++)
+    {
+        t[i] = (1 + (7 * i) % ntasks) * ms;
+        y[i] = -1;
+        h[i] = torc_task_future(i % torc_num_workers(), task, 2,
+                                1, MPI_INT, CALL_BY_COP,
+                                1, MPI_DOUBLE, CALL_BY_RES,
+                                &t[i], &y[i]);
+    }
+
+    //! consume the results as they arrive
+    int bad = 0;
+    int ndone = 0;
+    double first = 0;
+
+    while (ndone < ntasks)
+    {
+        int progress = 0;
+
+        for (int i = 0; i < ntasks; i++)
+        {
+            if ((h[i] != NULL) && torc_test(&h[i]))
+            {
+                if (ndone == 0)
+                {
+                    first = torc_gettime() - t0;
+                }
+                if (y[i] != 2.0 * t[i])
+                {
+                    bad++;
+                }
+                printf("task %3d: %4d ms, result = %6.0lf\n", i, t[i], y[i]);
+                ndone++;
+                progress = 1;
+            }
+        }
+
+        if (!progress)
+        {
+            torc_scheduler_loop(1);
+        }
+    }
+
+    //! a handle that has completed is released
+    for (int i = 0; i < ntasks; i++)
+    {
+        torc_wait(&h[i]);
+    }
+
+    double t1 = torc_gettime();
+
+    printf("first result after %.2lf ms, all after %.2lf ms, bad = %d\n", first * 1.0E3, (t1 - t0) * 1.0E3, bad);
+
+    free(t);
+    free(y);
+    free(h);
+
+    torc_finalize();
+    return 0;
+}
@@ -0,0 +1,102 @@
+/*
+ *  helpfirst.c
+ *  TORC_Lite
+ *
+ *  Created by Panagiotis Hadjidoukas on 1/1/14.
+ *  Copyright 2014 ETH Zurich. All rights reserved.
+ *
+ */
+
+/* help-first waiting:
+ * a nested task creates two short children and waits for them, while long
+ * unrelated tasks are queued on the same worker. With the default waiting
+ * policy the nested task may run a long task before its children; with
+ * TORC_WAIT_POLICY=descendants it runs its children first. Run it with one
+ * worker (TORC_WORKERS=1) and compare the wait time of the nested task.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <torc.h>
+
+#define DEF_NLONG 4
+#define DEF_LONG_MS 50
+
+void child(int *x, int *y)
+{
+    usleep(1000);
+    *y = 2 * (*x);
+}
+
+void nested(double *wait_ms)
+{
+    int x[2] = {1, 2};
+    int y[2] = {0, 0};
+
+    for (int i = 0; i < 2; i++)
+    {
+        torc_create(-1, child, 2,
+                    1, MPI_INT, CALL_BY_COP,
+                    1, MPI_INT, CALL_BY_RES,
+                    &x[i], &y[i]);
+    }
+
+    double t0 = torc_gettime();
+    torc_waitall();
+    *wait_ms = (torc_gettime() - t0) * 1.0E3;
+
+    if ((y[0] != 2) || (y[1] != 4))
+    {
+        printf("nested: wrong results %d %d\n", y[0], y[1]);
+    }
+}
+
+void simulation(int *ms)
+{
+    usleep(*ms * 1000);
+}
+
+int main(int argc, char *argv[])
+{
+    int nlong = DEF_NLONG;
+    int ms = DEF_LONG_MS;
+
+    if (argc > 1)
+    {
+        nlong = atoi(argv[1]);
+    }
+    if (argc > 2)
+    {
+        ms = atoi(argv[2]);
+    }
+
+    torc_register_task(child);
+    torc_register_task(nested);
+    torc_register_task(simulation);
+
+    torc_init(argc, argv);
+
+    double wait_ms = 0;
+
+    double t0 = torc_gettime();
+
+    //! the nested task and the unrelated simulations are queued on worker 0, in this order
+    torc_create(0, nested, 1,
+                1, MPI_DOUBLE, CALL_BY_RES,
+                &wait_ms);
+    for (int i = 0; i < nlong; i++)
+    {
+        torc_create(0, simulation, 1,
+                    1, MPI_INT, CALL_BY_COP,
+                    &ms);
+    }
+    torc_waitall();
+
+    double t1 = torc_gettime();
+
+    printf("nested task waited %.2lf ms for its children, all after %.2lf ms (a simulation takes %d ms)\n",
+           wait_ms, (t1 - t0) * 1.0E3, ms);
+
+    torc_finalize();
+    return 0;
+}
@@ -0,0 +1,94 @@
+/*
+ *  regbench.c
+ *  TORC_Lite
+ *
+ *  Created by Panagiotis Hadjidoukas on 1/1/14.
+ *  Copyright 2014 ETH Zurich. All rights reserved.
+ *
+ */
+
+/* task registry:
+ * 512 kernels are registered, then empty tasks of the first and of the last
+ * registered kernel are created and executed. Creating a task looks its
+ * function up in the table of tasks, so the two rates differ when the lookup
+ * depends on the number of registered functions.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <torc.h>
+
+#define DEF_NTASKS 200000
+#define BATCH 1000
+
+#define KERNEL(i) \
+    void kernel##i(void) {}
+#define KERNEL8(i) KERNEL(i##0) KERNEL(i##1) KERNEL(i##2) KERNEL(i##3) KERNEL(i##4) KERNEL(i##5) KERNEL(i##6) KERNEL(i##7)
+#define KERNEL64(i) KERNEL8(i##0) KERNEL8(i##1) KERNEL8(i##2) KERNEL8(i##3) KERNEL8(i##4) KERNEL8(i##5) KERNEL8(i##6) KERNEL8(i##7)
+
+KERNEL64(10)
+KERNEL64(11)
+KERNEL64(12)
+KERNEL64(13)
+KERNEL64(14)
+KERNEL64(15)
+KERNEL64(16)
+KERNEL64(17)
+
+#define REGISTER(i) torc_register_task(kernel##i);
+#define REGISTER8(i) REGISTER(i##0) REGISTER(i##1) REGISTER(i##2) REGISTER(i##3) REGISTER(i##4) REGISTER(i##5) REGISTER(i##6) REGISTER(i##7)
+#define REGISTER64(i) REGISTER8(i##0) REGISTER8(i##1) REGISTER8(i##2) REGISTER8(i##3) REGISTER8(i##4) REGISTER8(i##5) REGISTER8(i##6) REGISTER8(i##7)
+
+/**
+ * @brief Create and execute ntasks empty tasks of f, return the time per task in usecs
+ *
+ */
+double spawn(void (*f)(), long ntasks)
+{
+    double t0 = torc_gettime();
+
+    for (long i = 0; i < ntasks; i += BATCH)
+    {
+        for (int k = 0; k < BATCH; k++)
+        {
+            torc_create(-1, f, 0);
+        }
+        torc_waitall();
+    }
+
+    double t1 = torc_gettime();
+
+    return (t1 - t0) * 1.0E6 / ntasks;
+}
+
+int main(int argc, char *argv[])
+{
+    long ntasks = DEF_NTASKS;
+
+    if (argc > 1)
+    {
+        ntasks = atol(argv[1]);
+    }
+
+    REGISTER64(10)
+    REGISTER64(11)
+    REGISTER64(12)
+    REGISTER64(13)
+    REGISTER64(14)
+    REGISTER64(15)
+    REGISTER64(16)
+    REGISTER64(17)
+
+    torc_init(argc, argv);
+
+    //! warm up
+    spawn(kernel1000, BATCH);
+
+    double const first = spawn(kernel1000, ntasks);
+    double const last = spawn(kernel1777, ntasks);
+
+    printf("512 registered kernels, %ld tasks: first kernel %.3lf usecs/task, last kernel %.3lf usecs/task\n",
+           ntasks, first, last);
+
+    torc_finalize();
+    return 0;
+}
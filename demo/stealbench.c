@@ -0,0 +1,106 @@
+/*
+ *  stealbench.c
+ *  TORC_Lite
+ *
+ *  Created by Panagiotis Hadjidoukas on 1/1/14.
+ *  Copyright 2014 ETH Zurich. All rights reserved.
+ *
+ */
+
+/* inter-node stealing:
+ * all the tasks are created on the first worker of node 0 and the other nodes
+ * obtain work only by stealing. Reports the delay until each node runs its
+ * first task and how many tasks it executed. Run with TORC_STEAL_POLICY set to
+ * sequential, random, hierarchical or last.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <torc.h>
+
+#define DEF_NTASKS 200
+#define DEF_TASK_MS 5
+
+void task(int *ms, double *start, int *node)
+{
+    *start = torc_gettime();
+    *node = torc_node_id();
+
+    usleep(*ms * 1000);
+}
+
+int main(int argc, char *argv[])
+{
+    int ntasks = DEF_NTASKS;
+    int ms = DEF_TASK_MS;
+
+    if (argc > 1)
+    {
+        ntasks = atoi(argv[1]);
+    }
+    if (argc > 2)
+    {
+        ms = atoi(argv[2]);
+    }
+
+    torc_register_task(task);
+
+    torc_init(argc, argv);
+
+    int const nodes = torc_num_nodes();
+
+    double *start = (double *)malloc(ntasks * sizeof(double));
+    int *node = (int *)malloc(ntasks * sizeof(int));
+    double *first = (double *)malloc(nodes * sizeof(double));
+    int *count = (int *)calloc(nodes, sizeof(int));
+
+    torc_enable_stealing();
+
+    double t0 = torc_gettime();
+
+    for (int i = 0; i < ntasks; i++)
+    {
+        torc_create(0, task, 3,
+                    1, MPI_INT, CALL_BY_COP,
+                    1, MPI_DOUBLE, CALL_BY_RES,
+                    1, MPI_INT, CALL_BY_RES,
+                    &ms, &start[i], &node[i]);
+    }
+    torc_waitall();
+
+    double t1 = torc_gettime();
+
+    torc_disable_stealing();
+
+    for (int k = 0; k < nodes; k++)
+    {
+        first[k] = -1;
+    }
+
+    for (int i = 0; i < ntasks; i++)
+    {
+        int const k = node[i];
+        count[k]++;
+        if ((first[k] < 0) || (start[i] - t0 < first[k]))
+        {
+            first[k] = start[i] - t0;
+        }
+    }
+
+    char *s = getenv("TORC_STEAL_POLICY");
+
+    printf("nodes = %d, tasks = %d x %d ms, TORC_STEAL_POLICY = %s\n", nodes, ntasks, ms, (s != NULL) ? s : "default");
+    for (int k = 0; k < nodes; k++)
+    {
+        printf("node %3d: tasks = %4d, first task after %8.2lf ms\n", k, count[k], first[k] * 1.0E3);
+    }
+    printf("elapsed = %.2lf ms\n", (t1 - t0) * 1.0E3);
+
+    free(start);
+    free(node);
+    free(first);
+    free(count);
+
+    torc_finalize();
+    return 0;
+}
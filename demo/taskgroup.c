@@ -0,0 +1,216 @@
+/*
+ *  taskgroup.c
+ *  TORC_Lite
+ *
+ *  Created by Panagiotis Hadjidoukas on 1/1/14.
+ *  Copyright 2014 ETH Zurich. All rights reserved.
+ *
+ */
+
+/* task groups:
+ * speculative evaluations of different lengths run in a group. The first one
+ * that finishes wins and the group is cancelled: the queued evaluations are
+ * dropped and the running ones stop at their next poll of
+ * torc_taskgroup_cancelled.
+ * Then the members of a group, held back in dataflow mode behind a slow task,
+ * reach the queues only after many more groups have been cancelled: they must
+ * still be dropped.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <torc.h>
+
+#define DEF_NTASKS 32
+#define DEF_TASK_MS 20
+
+//! outcome of an evaluation
+#define NOT_RUN -1
+#define STOPPED 0
+#define FINISHED 1
+
+void evaluate(int *ms, int *outcome)
+{
+    for (int k = 0; k < *ms; k++)
+    {
+        if (torc_taskgroup_cancelled())
+        {
+            *outcome = STOPPED;
+            return;
+        }
+        usleep(1000);
+    }
+
+    *outcome = FINISHED;
+}
+
+//! groups cancelled after the first one
+#define NGROUPS 300
+
+/**
+ * @brief Slow task that the members of the first group depend on
+ *
+ */
+void gate(int *token)
+{
+    usleep(200 * 1000);
+    *token = 1;
+}
+
+/**
+ * @brief Member of the first group
+ *
+ */
+void member(int *token, int *ran)
+{
+    *ran = 1;
+}
+
+/**
+ * @brief Cancel a group whose members are still held back, then NGROUPS others
+ *
+ * @return int number of members of the first group that ran
+ */
+int cancel_many(int nmembers)
+{
+    int token = 0;
+    int *ran = (int *)calloc(nmembers, sizeof(int));
+
+    torc_enable_dataflow();
+
+    torc_create(-1, gate, 1,
+                1, MPI_INT, CALL_BY_RES,
+                &token);
+
+    torc_group_t first = torc_taskgroup_begin();
+    for (int i = 0; i < nmembers; i++)
+    {
+        torc_create(-1, member, 2,
+                    1, MPI_INT, CALL_BY_PTR,
+                    1, MPI_INT, CALL_BY_RES,
+                    &token, &ran[i]);
+    }
+    torc_taskgroup_end(first);
+
+    torc_disable_dataflow();
+
+    torc_taskgroup_cancel(first);
+
+    for (int g = 0; g < NGROUPS; g++)
+    {
+        torc_group_t other = torc_taskgroup_begin();
+        torc_taskgroup_end(other);
+        torc_taskgroup_cancel(other);
+        torc_taskgroup_wait(other);
+    }
+
+    torc_taskgroup_wait(first);
+    torc_waitall();
+
+    int n = 0;
+    for (int i = 0; i < nmembers; i++)
+    {
+        n += ran[i];
+    }
+    free(ran);
+
+    return n;
+}
+
+int main(int argc, char *argv[])
+{
+    int ntasks = DEF_NTASKS;
+    int ms = DEF_TASK_MS;
+
+    if (argc > 1)
+    {
+        ntasks = atoi(argv[1]);
+    }
+    if (argc > 2)
+    {
+        ms = atoi(argv[2]);
+    }
+
+    torc_register_task(evaluate);
+    torc_register_task(gate);
+    torc_register_task(member);
+
+    torc_init(argc, argv);
+
+    int *t = (int *)malloc(ntasks * sizeof(int));
+    int *outcome = (int *)malloc(ntasks * sizeof(int));
+    torc_handle_t *h = (torc_handle_t *)malloc(ntasks * sizeof(torc_handle_t));
+
+    double t0 = torc_gettime();
+
+    torc_group_t group = torc_taskgroup_begin();
+    for (int i = 0; i < ntasks; i++)
+    {
+        //! evaluation 1 is the shortest one
+        t[i] = (i == 1) ? ms : 10 * ms;
+        outcome[i] = NOT_RUN;
+        h[i] = torc_task_future(i % torc_num_workers(), evaluate, 2,
+                                1, MPI_INT, CALL_BY_COP,
+                                1, MPI_INT, CALL_BY_RES,
+                                &t[i], &outcome[i]);
+    }
+    torc_taskgroup_end(group);
+
+    //! wait for the first evaluation that finishes
+    int winner = -1;
+    while (winner < 0)
+    {
+        for (int i = 0; (i < ntasks) && (winner < 0); i++)
+        {
+            if ((h[i] != NULL) && torc_test(&h[i]))
+            {
+                winner = i;
+            }
+        }
+        //! the main worker does not pick up a long evaluation itself unless it is alone
+        if ((winner < 0) && (torc_num_workers() > 1))
+        {
+            usleep(100);
+        }
+        else if (winner < 0)
+        {
+            torc_scheduler_loop(1);
+        }
+    }
+
+    double t1 = torc_gettime();
+
+    torc_taskgroup_cancel(group);
+    torc_taskgroup_wait(group);
+
+    double t2 = torc_gettime();
+
+    for (int i = 0; i < ntasks; i++)
+    {
+        torc_wait(&h[i]);
+    }
+
+    int count[3] = {0, 0, 0};
+    for (int i = 0; i < ntasks; i++)
+    {
+        count[outcome[i] + 1]++;
+    }
+
+    printf("winner = %d after %.2lf ms, group cancelled after %.2lf ms (a full evaluation takes %d ms)\n",
+           winner, (t1 - t0) * 1.0E3, (t2 - t0) * 1.0E3, 10 * ms);
+    printf("finished = %d, stopped = %d, dropped = %d\n", count[FINISHED + 1], count[STOPPED + 1], count[NOT_RUN + 1]);
+
+    t0 = torc_gettime();
+    int const ran = cancel_many(ntasks);
+    t1 = torc_gettime();
+
+    printf("%d more groups cancelled after the first one: %d of its %d members ran (%.2lf ms)\n",
+           NGROUPS, ran, ntasks, (t1 - t0) * 1.0E3);
+
+    free(t);
+    free(outcome);
+    free(h);
+
+    torc_finalize();
+    return 0;
+}
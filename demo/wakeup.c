@@ -0,0 +1,90 @@
+/*
+ *  wakeup.c
+ *  TORC_Lite
+ *
+ *  Created by Panagiotis Hadjidoukas on 1/1/14.
+ *  Copyright 2014 ETH Zurich. All rights reserved.
+ *
+ */
+
+/* wake-up latency of idle workers:
+ * the main task spawns one task at a time, after a pause long enough for the
+ * other workers to park, and measures the time until the task starts running
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <torc.h>
+
+#define DEF_NTASKS 50
+#define DEF_PAUSE_MS 50
+
+void task(double *t0, double *latency, int *worker)
+{
+    *latency = torc_gettime() - *t0;
+    *worker = torc_worker_id();
+}
+
+int main(int argc, char *argv[])
+{
+    int ntasks = DEF_NTASKS;
+    int pause_ms = DEF_PAUSE_MS;
+
+    if (argc > 1)
+    {
+        ntasks = atoi(argv[1]);
+    }
+    if (argc > 2)
+    {
+        pause_ms = atoi(argv[2]);
+    }
+
+    torc_register_task(task);
+
+    torc_init(argc, argv);
+
+    //! with a single worker the main task would execute everything itself
+    int const spin = (torc_i_num_workers() > 1);
+
+    double sum = 0, max = 0, min = 1e30;
+
+    for (int i = 0; i < ntasks; i++)
+    {
+        usleep(pause_ms * 1000);
+
+        volatile double latency = -1;
+        int worker = -1;
+        double t0 = torc_gettime();
+
+        torc_create(-1, task, 3,
+                    1, MPI_DOUBLE, CALL_BY_COP,
+                    1, MPI_DOUBLE, CALL_BY_RES,
+                    1, MPI_INT, CALL_BY_RES,
+                    &t0, &latency, &worker);
+
+        //! leave the task to the (parked) workers
+        while (spin && (latency < 0))
+        {
+            sched_yield();
+        }
+
+        torc_waitall();
+
+        sum += latency;
+        if (latency > max)
+        {
+            max = latency;
+        }
+        if (latency < min)
+        {
+            min = latency;
+        }
+    }
+
+    printf("tasks = %d, pause = %d ms\n", ntasks, pause_ms);
+    printf("wake-up latency (usecs): avg = %.2lf, min = %.2lf, max = %.2lf\n",
+           sum / ntasks * 1.0E6, min * 1.0E6, max * 1.0E6);
+
+    torc_finalize();
+    return 0;
+}
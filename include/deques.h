@@ -0,0 +1,253 @@
+/*
+ *  deques.h
+ *  TORC_Lite
+ *
+ *  Created by Panagiotis Hadjidoukas on 1/1/14.
+ *  Copyright 2014 ETH Zurich. All rights reserved.
+ *
+ */
+
+/*! \file deques.h
+    \brief Lock-free work-stealing deques (Chase-Lev)
+
+    Each deque has a single owner that pushes and pops at the bottom (LIFO),
+    while any other thread may steal from the top (FIFO). The circular array
+    grows on demand; retired arrays are kept until _deque_destroy since a
+    concurrent thief may still be reading them.
+
+    Reference: N.M. Le, A. Pop, A. Cohen, F. Zappa Nardelli,
+    "Correct and Efficient Work-Stealing for Weak Memory Models", PPoPP 2013
+ */
+
+#ifndef __DEQUES_H__
+#define __DEQUES_H__
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+/* queues.h (CACHE_LINE_SIZE) should be included before deques.h */
+
+//! Initial capacity of a deque (must be a power of 2)
+#ifndef DEQUE_INITIAL_SIZE
+#define DEQUE_INITIAL_SIZE 1024
+#endif
+
+//! Return value of _deque_steal when it lost a race with another thread
+#define DEQUE_ABORT ((void *)-1)
+
+typedef struct _deque_array
+{
+    //! capacity - 1
+    long mask;
+    //! previously used (retired) array
+    struct _deque_array *retired;
+    //! circular buffer
+    _Atomic(void *) buf[];
+} deque_array_t;
+
+typedef struct _deque
+{
+    //! thieves side
+    atomic_long top;
+    char pad1[CACHE_LINE_SIZE - sizeof(atomic_long)];
+    //! owner side
+    atomic_long bottom;
+    _Atomic(deque_array_t *) array;
+    char pad2[CACHE_LINE_SIZE - sizeof(atomic_long) - sizeof(void *)];
+} deque_t;
+
+static inline deque_array_t *_deque_array_new(long size)
+{
+    deque_array_t *a = (deque_array_t *)malloc(sizeof(deque_array_t) + size * sizeof(_Atomic(void *)));
+    a->mask = size - 1;
+    a->retired = NULL;
+    return a;
+}
+
+static inline void _deque_init(deque_t *d)
+{
+    atomic_init(&d->top, 0);
+    atomic_init(&d->bottom, 0);
+    atomic_init(&d->array, _deque_array_new(DEQUE_INITIAL_SIZE));
+}
+
+static inline void _deque_destroy(deque_t *d)
+{
+    deque_array_t *a = atomic_load_explicit(&d->array, memory_order_relaxed);
+    while (a != NULL)
+    {
+        deque_array_t *r = a->retired;
+        free(a);
+        a = r;
+    }
+    atomic_store_explicit(&d->array, NULL, memory_order_relaxed);
+}
+
+/**
+ * @brief Replace the array of an empty deque by one that the calling thread allocates and touches (owner only)
+ * The pages of the new array are placed on the NUMA node of the owner; the old
+ * array is retired as when the deque grows
+ *
+ */
+static inline void _deque_rehome(deque_t *d)
+{
+    deque_array_t *a = atomic_load_explicit(&d->array, memory_order_relaxed);
+    deque_array_t *n = _deque_array_new(a->mask + 1);
+
+    memset((void *)n->buf, 0, (a->mask + 1) * sizeof(_Atomic(void *)));
+    n->retired = a;
+    atomic_store_explicit(&d->array, n, memory_order_release);
+}
+
+/**
+ * @brief Approximate number of items in the deque (exact for the owner)
+ *
+ */
+static inline long _deque_size(deque_t *d)
+{
+    long const b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    long const t = atomic_load_explicit(&d->top, memory_order_relaxed);
+    return (b > t) ? b - t : 0;
+}
+
+/**
+ * @brief Return the item a thief would get next, without removing it
+ * The item may be stolen concurrently, so the result is only a hint
+ *
+ */
+static inline void *_deque_peek_top(deque_t *d)
+{
+    long const t = atomic_load_explicit(&d->top, memory_order_acquire);
+    long const b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+    if (t >= b)
+    {
+        return NULL;
+    }
+    deque_array_t *a = atomic_load_explicit(&d->array, memory_order_acquire);
+    return atomic_load_explicit(&a->buf[t & a->mask], memory_order_relaxed);
+}
+
+/**
+ * @brief Adds an item at the bottom of the deque (owner only)
+ *
+ */
+static inline void _deque_push(deque_t *d, void *e)
+{
+    long const b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    long const t = atomic_load_explicit(&d->top, memory_order_acquire);
+    deque_array_t *a = atomic_load_explicit(&d->array, memory_order_relaxed);
+
+    if (b - t > a->mask)
+    {
+        deque_array_t *n = _deque_array_new(2 * (a->mask + 1));
+        for (long i = t; i < b; i++)
+        {
+            atomic_store_explicit(&n->buf[i & n->mask], atomic_load_explicit(&a->buf[i & a->mask], memory_order_relaxed), memory_order_relaxed);
+        }
+        n->retired = a;
+        atomic_store_explicit(&d->array, n, memory_order_release);
+        a = n;
+    }
+
+    atomic_store_explicit(&a->buf[b & a->mask], e, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+}
+
+/**
+ * @brief Removes the item at the bottom of the deque (owner only)
+ *
+ * @return the item or NULL if the deque is empty
+ */
+static inline void *_deque_pop(deque_t *d)
+{
+    long const b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+    deque_array_t *a = atomic_load_explicit(&d->array, memory_order_relaxed);
+    atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long t = atomic_load_explicit(&d->top, memory_order_relaxed);
+
+    void *e = NULL;
+    if (t <= b)
+    {
+        e = atomic_load_explicit(&a->buf[b & a->mask], memory_order_relaxed);
+        if (t == b)
+        {
+            //! last item, race against the thieves
+            if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+            {
+                e = NULL;
+            }
+            atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        }
+    }
+    else
+    {
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    }
+    return e;
+}
+
+/**
+ * @brief Removes the item at the top of the deque (any thread)
+ *
+ * @return the item, NULL if the deque is empty or DEQUE_ABORT if another thread won the race
+ */
+static inline void *_deque_steal(deque_t *d)
+{
+    long t = atomic_load_explicit(&d->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long const b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+
+    if (t >= b)
+    {
+        return NULL;
+    }
+
+    deque_array_t *a = atomic_load_explicit(&d->array, memory_order_acquire);
+    void *e = atomic_load_explicit(&a->buf[t & a->mask], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+    {
+        return DEQUE_ABORT;
+    }
+    return e;
+}
+
+//! Predicate of _deque_steal_if
+typedef int (*deque_accept_t)(void *e, void *arg);
+
+/**
+ * @brief Removes the item at the top of the deque if accept(item, arg) holds (any thread)
+ *
+ * The item is checked before it is claimed, so a rejected item stays at the top.
+ * The item cannot leave the deque while top is unchanged, hence the check still
+ * holds when the claim succeeds.
+ *
+ * @return the item, NULL if the deque is empty or the item is rejected, DEQUE_ABORT if another thread won the race
+ */
+static inline void *_deque_steal_if(deque_t *d, deque_accept_t accept, void *arg)
+{
+    long t = atomic_load_explicit(&d->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long const b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+
+    if (t >= b)
+    {
+        return NULL;
+    }
+
+    deque_array_t *a = atomic_load_explicit(&d->array, memory_order_acquire);
+    void *e = atomic_load_explicit(&a->buf[t & a->mask], memory_order_relaxed);
+    if (!accept(e, arg))
+    {
+        return NULL;
+    }
+    if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+    {
+        return DEQUE_ABORT;
+    }
+    return e;
+}
+
+#endif
@@ -40,7 +40,7 @@ typedef pthread_mutex_t _lock_t;
 #if defined(POSIX_MUTEX_LOCK)
 #define _lock_acquire(var) pthread_mutex_lock(var)
 #elif defined(POSIX_MUTEX_TRYLOCK)
-static int _lock_acquire(_lock_t *lock)
+static inline int _lock_acquire(_lock_t *lock)
 {
     /* Yield the processor to another thread or process. */
     while (pthread_mutex_trylock(lock) == EBUSY)
@@ -63,7 +63,7 @@ typedef pthread_spinlock_t _lock_t;
 #if defined(POSIX_SPIN_LOCK)
 #define _lock_acquire(var) pthread_spin_lock(var)
 #elif defined(POSIX_SPIN_TRYLOCK) /* from ompi */
-static int _lock_acquire(_lock_t *lock)
+static inline int _lock_acquire(_lock_t *lock)
 {
     volatile int count, delay, dummy;
     for (delay = 0; (pthread_spin_trylock(lock) == EBUSY);)
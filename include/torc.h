@@ -63,6 +63,9 @@ extern "C"
     void torc_disable_stealing(void);
     void torc_i_enable_stealing(void);
     void torc_i_disable_stealing(void);
+    void torc_enable_dataflow(void);
+    void torc_disable_dataflow(void);
+    void torc_set_inline(int flag);
     void start_server_thread(void);
     void shutdown_server_thread(void);
 
@@ -78,15 +81,69 @@ extern "C"
     void torc_task_ex(int queue, int invisible, void (*f)(), int narg, ...);
     void torc_task_direct(int queue, void (*f)(), int narg, ...);
 
+    /**
+     * @brief Handle of a single task, waited for with torc_wait or torc_test
+     * 
+     */
+    typedef struct torc_future *torc_handle_t;
+
+    torc_handle_t torc_task_future(int queue, void (*f)(), int narg, ...);
+    void torc_wait(torc_handle_t *handle);
+    int torc_test(torc_handle_t *handle);
+
+    /**
+     * @brief Group of tasks, waited for or cancelled together
+     * 
+     */
+    typedef struct torc_taskgroup *torc_group_t;
+
+    torc_group_t torc_taskgroup_begin(void);
+    void torc_taskgroup_end(torc_group_t group);
+    void torc_taskgroup_wait(torc_group_t group);
+    void torc_taskgroup_cancel(torc_group_t group);
+    int torc_taskgroup_cancelled(void);
+
 #define torc_create torc_task
 #define torc_create_detached torc_task_detached
 #define torc_create_ex torc_task_ex
 #define torc_create_direct torc_task_direct
+#define torc_create_future torc_task_future
 
     int torc_node_id(void);
     int torc_num_nodes(void);
     void torc_broadcast(void *a, long count, MPI_Datatype dtype);
+
+    /**
+     * @brief Handle of a broadcast, waited for with torc_ibroadcast_wait or torc_ibroadcast_test
+     * 
+     */
+    typedef struct torc_bcast *torc_bcast_t;
+
+    torc_bcast_t torc_ibroadcast(void *a, long count, MPI_Datatype dtype);
+    void torc_ibroadcast_wait(torc_bcast_t *handle);
+    int torc_ibroadcast_test(torc_bcast_t *handle);
     void torc_broadcast_ox(void *a, long count, int dtype);
+
+    /**
+     * @brief Combiner of a reduction: inout[i] = inout[i] (op) in[i], for count elements
+     * A user-defined combiner is registered with torc_register_task
+     * 
+     */
+    typedef void (*torc_combiner_t)(void *inout, void const *in, long count, MPI_Datatype dtype);
+
+    void torc_op_sum(void *inout, void const *in, long count, MPI_Datatype dtype);
+    void torc_op_prod(void *inout, void const *in, long count, MPI_Datatype dtype);
+    void torc_op_min(void *inout, void const *in, long count, MPI_Datatype dtype);
+    void torc_op_max(void *inout, void const *in, long count, MPI_Datatype dtype);
+
+#define TORC_SUM torc_op_sum
+#define TORC_PROD torc_op_prod
+#define TORC_MIN torc_op_min
+#define TORC_MAX torc_op_max
+
+    void torc_reduce(void *sendbuf, void *recvbuf, long count, MPI_Datatype dtype, torc_combiner_t op);
+    void torc_allreduce(void *sendbuf, void *recvbuf, long count, MPI_Datatype dtype, torc_combiner_t op);
+    void torc_gather(void *sendbuf, void *recvbuf, long count, MPI_Datatype dtype);
     void thread_sleep(int ms);
     void torc_finalize(void);
     int torc_fetch_work(void);
@@ -34,28 +34,69 @@ struct torc_data
     int _thread_safe;
     //!
     unsigned int _internode_stealing;
+    //! Dataflow mode: new tasks are ordered by the memory regions of their arguments
+    int _dataflow;
     //! Yielding time in miliseconds
     int _yieldtime;
-    //! 
+    //! A worker runs the tasks it creates inline once its deque holds this many (-1: never)
     int _throttling_factor;
+    //! Tasks deeper than this level run inline (-1: no cut-off)
+    int _cutoff_level;
+    //! Application hint (torc_set_inline): the tasks a worker creates run inline
+    int _inline_hint[MAX_NVPS];
+    //! Placement of the workers and the server thread (TORC_AFFINITY_*)
+    int _affinity;
+    //! Waiting policy of _torc_block (TORC_WAIT_ANY or TORC_WAIT_DESCENDANTS)
+    int _wait_policy;
+    //! Time without descendants after which a waiting task runs any task (-1: never)
+    int _wait_usecs;
+    //! Levels below the waiting task from which other tasks are run meanwhile (-1: none)
+    int _wait_levels;
+    //! Size threshold of the per-destination batches of remote enqueues (0: no batching)
+    int _aggr_bytes;
+    //! Maximum delay of a non-empty batch in microseconds
+    int _aggr_usecs;
+    //! Victim selection policy of inter-node stealing
+    int _steal_policy;
+    //! Maximum number of tasks a victim hands over at once (up to half of its queues)
+    int _steal_chunk;
+    //! Maximum number of outstanding stealing requests of the node (to different victims)
+    int _steal_window;
+    //! Thieves take the tasks from the stealing windows of the victims (MPI-3 RMA)
+    int _steal_rma;
     //! Server thread
     pthread_t _server_thread;
     //! Woker threads
     pthread_t _worker_thread[MAX_NVPS];
     /* read write */
-    queue_t _reuse_q;
+    //! free descriptors per size class: one cache per worker, the server thread and other threads
+    desc_cache_t _desc_cache[TORC_DESC_NCLASSES][MAX_NVPS + 2];
+    desc_depot_t _desc_depot[TORC_DESC_NCLASSES];
     queue_t _private_grq;
-    queue_t _public_grq[10];
+    //! shared queue for threads that do not own a deque (e.g. the server thread)
+    queue_t _public_grq;
+    //! per virtual processor work-stealing deques
+    deque_t _public_wsq[MAX_NVPS];
+    //! per virtual processor local ready queues (explicit worker placement)
+    queue_t _public_lrq[MAX_NVPS];
     //!
     unsigned long _created[MAX_NVPS];
     //!
     unsigned long _executed[MAX_NVPS];
+    //! messages sent through the shared-memory rings
+    unsigned long _shm_messages;
+    //! tasks executed inline by their creator
+    unsigned long _inlined[MAX_NVPS];
     //!
     unsigned long _steal_hits;
     //!
     unsigned long _steal_served;
     //!
     unsigned long _steal_attempts;
+    //! Stealing requests of this node and their latency in seconds
+    unsigned long _steal_requests;
+    double _steal_latency;
+    double _steal_latency_max;
     //! Virtual processor key
     pthread_key_t _vp_key;
     //! Current key
@@ -74,21 +115,42 @@ extern struct torc_data *torc_data;
 
 #define thread_safe torc_data->_thread_safe
 #define internode_stealing torc_data->_internode_stealing
+#define dataflow torc_data->_dataflow
 #define yieldtime torc_data->_yieldtime
 #define throttling_factor torc_data->_throttling_factor
+#define cutoff_level torc_data->_cutoff_level
+#define inline_hint torc_data->_inline_hint
+#define affinity torc_data->_affinity
+#define wait_policy torc_data->_wait_policy
+#define wait_usecs torc_data->_wait_usecs
+#define wait_levels torc_data->_wait_levels
+#define aggr_bytes torc_data->_aggr_bytes
+#define aggr_usecs torc_data->_aggr_usecs
+#define steal_policy torc_data->_steal_policy
+#define steal_chunk torc_data->_steal_chunk
+#define steal_window torc_data->_steal_window
+#define steal_rma torc_data->_steal_rma
 
 #define server_thread torc_data->_server_thread
 #define worker_thread torc_data->_worker_thread
 
-#define reuse_q torc_data->_reuse_q
+#define desc_cache torc_data->_desc_cache
+#define desc_depot torc_data->_desc_depot
 #define private_grq torc_data->_private_grq
 #define public_grq torc_data->_public_grq
+#define public_wsq torc_data->_public_wsq
+#define public_lrq torc_data->_public_lrq
 
 #define created torc_data->_created
 #define executed torc_data->_executed
+#define inlined torc_data->_inlined
+#define shm_messages torc_data->_shm_messages
 #define steal_hits torc_data->_steal_hits
 #define steal_served torc_data->_steal_served
 #define steal_attempts torc_data->_steal_attempts
+#define steal_requests torc_data->_steal_requests
+#define steal_latency torc_data->_steal_latency
+#define steal_latency_max torc_data->_steal_latency_max
 #define vp_key torc_data->_vp_key
 #define currt_key torc_data->_currt_key
 
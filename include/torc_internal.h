@@ -19,6 +19,9 @@
 #include <string.h>
 #include <stdarg.h>
 #include <sys/time.h>
+#include <stddef.h>
+#include <sched.h>
+#include <stdatomic.h>
 
 #include <torc_config.h>
 
@@ -32,7 +35,7 @@
 #define MAX_TORC_ARGS 24
 #endif
 
-//! Maximum number of the tasks that the TORC library can register
+//! Initial size of the table of registered tasks, doubled whenever it is full
 #ifndef MAX_TORC_TASKS
 #define MAX_TORC_TASKS 128
 #endif
@@ -43,6 +46,53 @@
 //! 10ms default yield-time
 #define TORC_DEF_YIELDTIME 10
 
+//! 16KB default batches of remote enqueues
+#define TORC_DEF_AGGR_BYTES 16384
+
+//! 200us default delay of a batch
+#define TORC_DEF_AGGR_USECS 200
+
+//! Victim selection policies of inter-node stealing
+#define TORC_STEAL_SEQUENTIAL 0
+#define TORC_STEAL_RANDOM 1
+#define TORC_STEAL_HIERARCHICAL 2
+#define TORC_STEAL_LAST_VICTIM 3
+
+#define TORC_DEF_STEAL_POLICY TORC_STEAL_HIERARCHICAL
+
+//! Maximum number of tasks in the reply to a stealing request
+#define TORC_DEF_STEAL_CHUNK 32
+#define TORC_STEAL_CHUNK_MAX 256
+
+//! Outstanding stealing requests of a node
+#define TORC_DEF_STEAL_WINDOW 2
+
+//! Inter-node stealing is on unless TORC_STEALING=0
+#define TORC_DEF_STEALING 1
+
+//! Thieves send stealing requests unless TORC_STEAL_RMA=1 (one-sided stealing windows)
+#define TORC_DEF_STEAL_RMA 0
+
+//! Waiting policies of _torc_block
+//! a waiting task runs any task
+#define TORC_WAIT_ANY 0
+//! a waiting task runs its descendants first, other tasks only within bounds
+#define TORC_WAIT_DESCENDANTS 1
+
+#define TORC_DEF_WAIT_POLICY TORC_WAIT_ANY
+
+//! A waiting task runs any task after this many microseconds without descendants
+#define TORC_DEF_WAIT_USECS 1000
+
+//! Before that, only tasks at least this many levels deeper than the waiting task (-1: none)
+#define TORC_DEF_WAIT_LEVELS 2
+
+//! Placement policies of TORC_AFFINITY
+#define TORC_AFFINITY_NONE 0
+#define TORC_AFFINITY_COMPACT 1
+#define TORC_AFFINITY_SCATTER 2
+#define TORC_AFFINITY_LIST 3
+
 typedef int INT32;
 typedef long long INT64;
 typedef unsigned long VIRT_ADDR;
@@ -52,16 +102,58 @@ typedef void (*func_t)();
 
 struct torc_desc;
 
-typedef struct torc_desc
+/**
+ * @brief Argument record of a TORC descriptor
+ *
+ */
+typedef struct torc_arg
 {
-    //! Mutex
-    _lock_t lock;
+    //! data (address / value) in the owner node
+    INT64 localarg;
+    //! data (address / value) in the remote node
+    INT64 temparg;
+    //! MPI_Datatype of the argument
+    MPI_Datatype dtype;
+    //! TORC type of the argument
+    int btype;
+    //! Number of data items of the argument
+    int quantity;
+    //!
+    int callway;
+} torc_arg_t;
 
+/**
+ * @brief Completion record of a task created with torc_task_future
+ *
+ */
+typedef struct torc_future
+{
+    //! 1 once the task has finished and its results are in place
+    atomic_int done;
+    //! worker of the creator, woken up at completion
+    long vp_id;
+    //! the record belongs to a handle (torc_task_future), else it is freed at completion
+    int handle;
+    //! dataflow mode: the task is held back until its npred predecessors have finished
+    int tracked;
+    int npred;
+    int queue;
+    struct torc_desc *desc;
+    //! tasks that wait for this one
+    struct torc_future **succ;
+    int nsucc;
+    int maxsucc;
+} torc_future_t;
+
+typedef struct torc_desc
+{
     //! pointers for the double linked-list queue
     struct torc_desc *prev;
     struct torc_desc *next;
     //!
     struct torc_desc *parent;
+    //! completion record of the task, NULL if none (an address of the home node)
+    struct torc_future *future;
     //! Virtual processor ID
     long vp_id;
     //! Function pointer
@@ -70,8 +162,8 @@ typedef struct torc_desc
     int work_id;
     //! Number of arguments of the function
     int narg;
-    //!
-    int ndep;
+    //! outstanding dependencies (children), updated atomically
+    atomic_int ndep;
     //!
     int homenode;
     //!
@@ -92,27 +184,54 @@ typedef struct torc_desc
     int type;
     //!
     int level;
-    //! TORC type of each arguments of Function pointer
-    int btype[MAX_TORC_ARGS];
-    //! MPI_Datatype of each arguments of Function pointer
-    MPI_Datatype dtype[MAX_TORC_ARGS];
-    //! Number of each data of each arguments of Function pointer
-    int quantity[MAX_TORC_ARGS];
-    //! 
-    int callway[MAX_TORC_ARGS];
-    //! data (address / value) in the owner node
-    INT64 localarg[MAX_TORC_ARGS]; 
-    //! data (address / value) in the remote node
-    INT64 temparg[MAX_TORC_ARGS];
+    //! the sender had ready tasks when it sent the message (piggybacked hint)
+    int work_hint;
+    //! task group: node of the group and its id there (0: no group)
+    int group_node;
+    int group_id;
+    //! local copies of the arguments of a remote task (one block)
+    void *payload;
+    //! size class of the descriptor pool (-1: not pooled)
+    int sclass;
+    //! dropped by the cancellation of its group, no results
+    int cancelled;
+    //! argument records (narg entries, sized by the size class)
+    torc_arg_t arg[];
 } torc_t;
 
+//! Size in bytes of a descriptor with n argument records
+#define TORC_DESC_SIZE(n) (offsetof(torc_t, arg) + (n) * sizeof(torc_arg_t))
+
+//! Number of argument records of a control message descriptor
+#define TORC_CTL_NARG 4
+
+/**
+ * @brief Descriptor of a control message, allocated on the stack
+ *
+ */
+typedef union torc_ctl {
+    torc_t desc;
+    char space[TORC_DESC_SIZE(TORC_CTL_NARG)];
+} torc_ctl_t;
+
 /* Internal */
 torc_t *_torc_self(void);
 torc_t *_torc_get_currt(void);
 
 int _torc_depsatisfy(torc_t *);
+int _torc_depsatisfy_n(torc_t *, int);
 
 void _torc_depadd(torc_t *, int);
+void _torc_depinit(torc_t *);
+void _torc_future_complete(torc_future_t *);
+void _torc_task_copyin(torc_t *);
+int _torc_dataflow_register(torc_t *, int, VIRT_ADDR const *);
+void _torc_dataflow_complete(torc_future_t *);
+void _torc_group_join(torc_t *, torc_t *);
+void _torc_group_done(torc_t *);
+int _torc_group_cancelled(int, int);
+void _torc_group_mark_cancelled(int, int);
+void _torc_group_end(void);
 void _torc_core_execution(torc_t *);
 void _torc_set_work_routine(torc_t *, void (*)());
 void _torc_switch(torc_t *, torc_t *, int);
@@ -134,6 +253,16 @@ void *_torc_worker(void *arg);
 void _torc_execute(void *);
 void _torc_set_vpid(long);
 long _torc_get_vpid(void);
+void _torc_idle(int);
+void _torc_idle_reset(int);
+void _torc_wake_one(void);
+int _torc_wake_vp(int);
+void _torc_wake_all(void);
+int _torc_affinity_policy(char const *);
+void _torc_affinity_init(void);
+void _torc_affinity_attr(pthread_attr_t *, long);
+int _torc_affinity_pinned(void);
+void _torc_affinity_report(void);
 
 /* Exported interface */
 #include "torc_queue.h"
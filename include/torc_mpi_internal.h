@@ -16,16 +16,19 @@
 
 #define TERMINATE_LOCAL_SERVER_THREAD 120
 #define TERMINATE_WORKER_THREADS 121
-#define DIRECT_SYNCHRONOUS_STEALING_REQUEST 123
-#define DISABLE_INTERNODE_STEALING 124
-#define ENABLE_INTERNODE_STEALING 125
+#define TORC_STEAL_REQUEST 123
 #define RESET_STATISTICS 126
 
 #define TORC_NORMAL 139
 #define TORC_ANSWER 140
 #define TORC_NORMAL_ENQUEUE 141
-#define TORC_NO_WORK 142
 #define TORC_BCAST 145
+#define TORC_BATCH 146
+#define TORC_STEAL_REPLY 147
+#define TORC_GROUP_CANCEL 148
+#define TORC_BCAST_DONE 149
+#define TORC_REDUCE 150
+#define TORC_GATHER 151
 
 enum
 {
@@ -65,10 +68,15 @@ struct node_info
 {
     int nprocessors;
     int nworkers;
+    //! lowest node on the same host
+    int host;
 };
 
 extern struct node_info *node_info;
 
+//! Set once the server thread is asked to terminate
+extern volatile int termination_flag;
+
 #define Error(msg)                                  \
     {                                               \
         printf("ERROR in %s: %s\n", __func__, msg); \
@@ -91,6 +99,19 @@ extern struct node_info *node_info;
     }
 
 
+/**
+ * @brief Completion callback of a request owned by the progress engine
+ *
+ */
+typedef void (*torc_progress_cb)(void *arg);
+
+void torc_progress_post(MPI_Request request, torc_progress_cb cb, void *arg);
+int torc_progress(void);
+int torc_progress_pending(void);
+void torc_progress_countdown(void *arg);
+void torc_progress_wait(volatile int *counter);
+void torc_progress_drain(void);
+
 int global_thread_id_to_node_id(int global_thread_id);
 int local_thread_id_to_global_thread_id(int local_thread_id);
 int global_thread_id_to_local_thread_id(int global_thread_id);
@@ -103,10 +124,35 @@ void *server_loop(void *arg);
 //! notify_appl_finished()
 void terminate_workers(void);
 void send_descriptor(int, torc_t *, int);
-void direct_send_descriptor(int dummy, int sourcenode, int sourcevpid, torc_t *desc);
-void receive_arguments(torc_t *work, int tag);
-void receive_descriptor(int node, torc_t *work);
-torc_t *direct_synchronous_stealing_request(int target_node);
+void post_descriptor(int, torc_t *, int);
+void post_steal_reply(int node, int vp, torc_t **descs, int n);
+void unpack_arguments(torc_t *desc);
+void unpack_results(torc_t *desc);
+torc_t *receive_probed_descriptor(MPI_Status *status, int tag);
+torc_t *receive_buffered_descriptor(char const *in, size_t count);
+torc_t *unpack_batch(torc_t *batch, char **cursor);
+void torc_aggr_flush(int expired);
+int torc_aggr_pending(void);
+int _torc_steal_policy(char const *s);
+void _torc_steal_init(void);
+void _torc_steal(void);
+void _torc_steal_reply(torc_t *reply);
+void _torc_steal_hint(int node, int hint);
+void _torc_shm_init(void);
+void _torc_shm_end(void);
+int torc_shm_peer(int node);
+char *torc_shm_reserve(int node, size_t len, long *pos);
+void torc_shm_commit(int node, long pos);
+int torc_shm_send(int node, void const *msg, size_t len);
+torc_t *torc_shm_receive(void);
+void _torc_bcast_relay(torc_t *desc);
+void _torc_bcast_done(torc_t *desc);
+void _torc_gather_relay(torc_t *desc, int type);
+size_t pack_published(char *out, size_t room, torc_t *desc);
+void _torc_rma_init(void);
+void _torc_rma_end(void);
+void _torc_rma_serve(void);
+int _torc_rma_steal(int victim, int vp);
 func_t getfuncptr(int funcpos);
 int getfuncnum(func_t f);
 int _torc_mpi2b_type(MPI_Datatype dtype);
@@ -13,15 +13,65 @@
 /* Data structure */
 QUEUE_DEFINE(torc_t, queue_t);
 
+//! Number of descriptors handed between a thread cache and the depot at once
+#define TORC_DESC_BATCH 64
+
+//! Number of descriptors carved out of a single slab
+#define TORC_DESC_SLAB 256
+
+//! Number of descriptor size classes (by number of arguments)
+#define TORC_DESC_NCLASSES 4
+
+/**
+ * @brief Per-thread cache of free descriptors (linked through next)
+ *
+ */
+typedef union _desc_cache {
+    struct
+    {
+        torc_t *head;
+        unsigned int count;
+    } c;
+    char pad[CACHE_LINE_SIZE];
+} desc_cache_t;
+
+/**
+ * @brief Node-wide depot of full batches of free descriptors
+ * A batch is a list of TORC_DESC_BATCH descriptors linked through next,
+ * batches are linked through the prev field of their first descriptor
+ *
+ */
+typedef struct _desc_depot
+{
+    _lock_t lock;
+    torc_t *batches;
+    //! number of allocated slabs
+    unsigned long nslabs;
+} desc_depot_t;
+
 void rq_init(void);
+void rq_localize(int vp);
 
 void torc_to_i_pq(torc_t *desc);
 void torc_to_i_pq_end(torc_t *desc);
 torc_t *torc_i_pq_dequeue(void);
 
+//! Victim-selection policies of torc_i_rq_dequeue
+//! intra-node: prefer the most fine-grained (deepest) work
+#define TORC_RQ_DEEPEST 0
+//! inter-node: prefer the most coarse-grained (shallowest) work
+#define TORC_RQ_SHALLOWEST 1
+
 void torc_to_i_rq(torc_t *desc);
 void torc_to_i_rq_end(torc_t *desc);
-torc_t *torc_i_rq_dequeue(int lvl);
+torc_t *torc_i_rq_dequeue(int policy);
+int torc_i_rq_available();
+long torc_i_rq_size(long max);
+
+//! Selection predicate of torc_i_rq_select
+typedef int (*torc_select_t)(torc_t *desc, torc_t *self);
+
+torc_t *torc_i_rq_select(torc_select_t accept, torc_t *self);
 
 void torc_to_i_lrq(int which, torc_t *desc);
 void torc_to_i_lrq_end(int which, torc_t *desc);
@@ -32,7 +82,8 @@ torc_t *torc_i_lrq_dequeue_inner(int which);
 torc_t *torc_i_lrq_dequeue_end_inner(int which);
 
 void _torc_put_reused_desc(torc_t *desc);
-torc_t *_torc_get_reused_desc(void);
+torc_t *_torc_get_reused_desc(int narg);
+size_t _torc_desc_pool_size(int narg);
 
 void torc_to_nrq(int node, torc_t *desc);
 void torc_to_nrq_end(int node, torc_t *desc);
@@ -12,5 +12,6 @@
 
 #include "locks.h"
 #include "queues.h"
+#include "deques.h"
 
 #endif
@@ -41,27 +41,10 @@ void torc_waitall3()
 {
     torc_t *self = _torc_self();
 
-    {
-        _lock_acquire(&self->lock);
-        --self->ndep;
-        _lock_release(&self->lock);
-    }
+    atomic_fetch_sub_explicit(&self->ndep, 1, memory_order_release);
 
-    int remdeps;
-
-    while (1)
+    while (atomic_load_explicit(&self->ndep, memory_order_acquire) != 0)
     {
-        {
-            _lock_acquire(&self->lock);
-            remdeps = self->ndep;
-            _lock_release(&self->lock);
-        }
-
-        if (remdeps == 0)
-        {
-            break;
-        }
-
         thread_sleep(0);
     }
 }
@@ -71,6 +54,22 @@ int torc_scheduler_loop(int once)
     return _torc_scheduler_loop(once);
 }
 
+/**
+ * @brief Application hint: the tasks that the calling worker creates run inline
+ * Tasks placed on another worker are still enqueued on that worker
+ *
+ * @param flag 1 to run new tasks inline, 0 to enqueue them
+ */
+void torc_set_inline(int flag)
+{
+    long const vp = _torc_self()->vp_id;
+
+    if ((vp >= 0) && (vp < (long)kthreads))
+    {
+        inline_hint[vp] = flag;
+    }
+}
+
 #ifdef TORC_STATS
 /**
  * @brief Set the invisible flag
@@ -98,10 +97,9 @@ void torc_task_detached(int queue, void (*work)(), int narg, ...)
         Error("narg > MAX_TORC_ARGS!");
     }
 
-    torc_t *desc = _torc_get_reused_desc();
+    torc_t *desc = _torc_get_reused_desc(narg);
 
     {
-        _lock_init(&desc->lock);
         //! It is a detached thread
         desc->parent = NULL;
         desc->vp_id = -1;
@@ -122,65 +120,65 @@ void torc_task_detached(int queue, void (*work)(), int narg, ...)
 
     for (int i = 0; i < narg; i++)
     {
-        desc->quantity[i] = va_arg(ap, int);
-        desc->dtype[i] = va_arg(ap, MPI_Datatype);
-        desc->btype[i] = _torc_mpi2b_type(desc->dtype[i]);
-        desc->callway[i] = va_arg(ap, int);
+        desc->arg[i].quantity = va_arg(ap, int);
+        desc->arg[i].dtype = va_arg(ap, MPI_Datatype);
+        desc->arg[i].btype = _torc_mpi2b_type(desc->arg[i].dtype);
+        desc->arg[i].callway = va_arg(ap, int);
 
-        if ((desc->callway[i] == CALL_BY_COP) && (desc->quantity[i] > 1))
+        if ((desc->arg[i].callway == CALL_BY_COP) && (desc->arg[i].quantity > 1))
         {
-            desc->callway[i] = CALL_BY_COP2;
+            desc->arg[i].callway = CALL_BY_COP2;
         }
 
 #if DEBUG
-        printf("ARG %d : Q = %d, T = %d, C = %x O\n", i, desc->quantity[i], desc->dtype[i], desc->callway[i]);
+        printf("ARG %d : Q = %d, T = %d, C = %x O\n", i, desc->arg[i].quantity, desc->arg[i].dtype, desc->arg[i].callway);
         fflush(0);
 #endif
     }
 
     for (int i = 0; i < narg; i++)
     {
-        if (desc->quantity[i] == 0)
+        if (desc->arg[i].quantity == 0)
         {
             VIRT_ADDR dummy;
             dummy = va_arg(ap, VIRT_ADDR);
             continue;
         }
-        if (desc->callway[i] == CALL_BY_COP)
+        if (desc->arg[i].callway == CALL_BY_COP)
         {
             int typesize;
-            MPI_Type_size(desc->dtype[i], &typesize);
+            MPI_Type_size(desc->arg[i].dtype, &typesize);
 
             switch (typesize)
             {
             case 4:
-                desc->localarg[i] = *va_arg(ap, INT32 *);
+                desc->arg[i].localarg = *va_arg(ap, INT32 *);
                 break;
             case 8:
-                desc->localarg[i] = *va_arg(ap, INT64 *);
+                desc->arg[i].localarg = *va_arg(ap, INT64 *);
                 break;
             default:
                 Error("Type size is not 4 or 8!");
                 break;
             }
         }
-        else if (desc->callway[i] == CALL_BY_COP2)
+        else if (desc->arg[i].callway == CALL_BY_COP2)
         {
             int typesize;
-            MPI_Type_size(desc->dtype[i], &typesize);
+            MPI_Type_size(desc->arg[i].dtype, &typesize);
 
-            void *pmem = malloc(desc->quantity[i] * typesize);
+            void *pmem = malloc(desc->arg[i].quantity * typesize);
 
             VIRT_ADDR addr = va_arg(ap, VIRT_ADDR);
 
-            memcpy(pmem, (void *)addr, desc->quantity[i] * typesize);
+            memcpy(pmem, (void *)addr, desc->arg[i].quantity * typesize);
 
-            desc->localarg[i] = (INT64)pmem;
+            desc->arg[i].localarg = (INT64)pmem;
         }
         else
         {
             //! pointer (C: PTR, VAL)
-            desc->localarg[i] = va_arg(ap, VIRT_ADDR);
+            desc->arg[i].localarg = va_arg(ap, VIRT_ADDR);
         }
     }
 
@@ -196,14 +194,131 @@ void torc_task_detached(int queue, void (*work)(), int narg, ...)
 }
 
 /**
- * @brief Execute the task  
- * 
- * @param queue 
+ * @brief Replace the addresses of the arguments passed by copy with their values
+ *
+ * @param desc TORC descriptor
+ */
+void _torc_task_copyin(torc_t *desc)
+{
+    for (int i = 0; i < desc->narg; i++)
+    {
+        if (desc->arg[i].quantity == 0)
+        {
+            continue;
+        }
+
+        if (desc->arg[i].callway == CALL_BY_COP)
+        {
+            int typesize;
+            MPI_Type_size(desc->arg[i].dtype, &typesize);
+
+            switch (typesize)
+            {
+            case 4:
+                desc->arg[i].localarg = *(INT32 *)desc->arg[i].localarg;
+                break;
+            case 8:
+                desc->arg[i].localarg = *(INT64 *)desc->arg[i].localarg;
+                break;
+            default:
+                Error("Type size is not 4 or 8!");
+                break;
+            }
+        }
+        else if (desc->arg[i].callway == CALL_BY_COP2)
+        {
+            int typesize;
+            MPI_Type_size(desc->arg[i].dtype, &typesize);
+
+            void *pmem = malloc(desc->arg[i].quantity * typesize);
+
+            memcpy(pmem, (void *)desc->arg[i].localarg, desc->arg[i].quantity * typesize);
+
+            desc->arg[i].localarg = (INT64)pmem;
+        }
+        //! else pointer (C: PTR, VAL)
+    }
+}
+
+/**
+ * @brief Whether a new task of self runs inline (work-first) instead of being enqueued
+ * The cut-off is the application hint (torc_set_inline), the level of the task
+ * (TORC_CUTOFF_LEVEL) or the depth of the deque of the worker (TORC_THROTTLING_FACTOR).
+ * A task placed on a worker other than the creator is never run inline
+ *
+ * @param self  creator
+ * @param queue target queue of the task (-1: any)
+ * @return int 1 to run the task inline
+ */
+static int torc_task_inline(torc_t *self, int queue)
+{
+    long const vp = self->vp_id;
+
+    //! dataflow and group members keep their ordering and accounting
+    if ((vp < 0) || (vp >= (long)kthreads) || dataflow || self->group_id)
+    {
+        return 0;
+    }
+
+    //! an explicit placement on another worker is kept
+    if ((queue != -1) && (queue != local_thread_id_to_global_thread_id((int)vp)))
+    {
+        return 0;
+    }
+
+    if (inline_hint[vp])
+    {
+        return 1;
+    }
+
+    if ((cutoff_level >= 0) && (self->level + 1 > cutoff_level))
+    {
+        return 1;
+    }
+
+    if ((throttling_factor > 0) && (_deque_size(&public_wsq[vp]) >= throttling_factor))
+    {
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Run a new task in the context of its creator
+ *
+ * @param self creator
+ * @param desc TORC descriptor, its arguments already copied in
+ */
+static void torc_task_run_inline(torc_t *self, torc_t *desc)
+{
+    desc->vp_id = self->vp_id;
+
+#ifdef TORC_STATS
+    if (desc->rte_type == 1)
+    {
+        executed[self->vp_id]++;
+    }
+    inlined[self->vp_id]++;
+#endif
+
+    _torc_set_currt(desc);
+    _torc_core_execution(desc);
+    _torc_set_currt(self);
+
+    _torc_cleanup(desc);
+}
+
+/**
+ * @brief Create a task from a list of arguments
+ *
+ * @param queue
+ * @param future completion record of the task (may be NULL)
  * @param work   Callable object to execute in the thread
  * @param narg   Number of arguments of this callable object
- * @param ... 
+ * @param ap     Arguments
  */
-void torc_task(int queue, void (*work)(), int narg, ...)
+static void torc_task_va(int queue, torc_future_t *future, void (*work)(), int narg, va_list ap)
 {
     if (narg > MAX_TORC_ARGS)
     {
@@ -212,21 +327,23 @@ void torc_task(int queue, void (*work)(), int narg, ...)
 
     torc_t *self = _torc_self();
 
-    //! Check if rte_init has been called
-    _lock_acquire(&self->lock);
-    if (self->ndep == 0)
+    //! work-first: below the cut-off the creator runs the task itself and does not wait for it
+    int const run_inline = torc_task_inline(self, queue);
+
+    if (!run_inline)
     {
-        self->ndep = 1;
-    }
-    _lock_release(&self->lock);
+        //! Check if rte_init has been called
+        _torc_depinit(self);
 
-    _torc_depadd(self, 1);
+        _torc_depadd(self, 1);
+    }
 
-    torc_t *desc = _torc_get_reused_desc();
+    torc_t *desc = _torc_get_reused_desc(narg);
 
     {
-        _lock_init(&desc->lock);
-        desc->parent = self;
+        desc->parent = run_inline ? NULL : self;
+        _torc_group_join(self, desc);
+        desc->future = future;
         desc->vp_id = -1;
         _torc_set_work_routine(desc, work);
         desc->work_id = -1;
@@ -253,72 +370,55 @@ void torc_task(int queue, void (*work)(), int narg, ...)
 #endif
     }
 
-    va_list ap;
-    va_start(ap, narg);
-
     for (int i = 0; i < narg; i++)
     {
-        desc->quantity[i] = va_arg(ap, int);
-        desc->dtype[i] = va_arg(ap, MPI_Datatype);
-        desc->btype[i] = _torc_mpi2b_type(desc->dtype[i]);
-        desc->callway[i] = va_arg(ap, int);
+        desc->arg[i].quantity = va_arg(ap, int);
+        desc->arg[i].dtype = va_arg(ap, MPI_Datatype);
+        desc->arg[i].btype = _torc_mpi2b_type(desc->arg[i].dtype);
+        desc->arg[i].callway = va_arg(ap, int);
 
-        if ((desc->callway[i] == CALL_BY_COP) && (desc->quantity[i] > 1))
+        if ((desc->arg[i].callway == CALL_BY_COP) && (desc->arg[i].quantity > 1))
         {
-            desc->callway[i] = CALL_BY_COP2;
+            desc->arg[i].callway = CALL_BY_COP2;
         }
 
 #if DEBUG
-        printf("ARG %d : Q = %d, T = %d, C = %x O\n", i, desc->quantity[i], desc->dtype[i], desc->callway[i]);
+        printf("ARG %d : Q = %d, T = %d, C = %x O\n", i, desc->arg[i].quantity, desc->arg[i].dtype, desc->arg[i].callway);
         fflush(0);
 #endif
     }
 
     for (int i = 0; i < narg; i++)
     {
-        if (desc->quantity[i] == 0)
+        if (desc->arg[i].quantity == 0)
         {
             VIRT_ADDR dummy;
             dummy = va_arg(ap, VIRT_ADDR);
             continue;
         }
 
-        if (desc->callway[i] == CALL_BY_COP)
-        {
-            int typesize;
-            MPI_Type_size(desc->dtype[i], &typesize);
-
-            switch (typesize)
-            {
-            case 4:
-                desc->localarg[i] = *va_arg(ap, INT32 *);
-                break;
-            case 8:
-                desc->localarg[i] = *va_arg(ap, INT64 *);
-                break;
-            default:
-                Error("Type size is not 4 or 8!");
-                break;
-            }
-        }
-        else if (desc->callway[i] == CALL_BY_COP2)
-        {
-            int typesize;
-            MPI_Type_size(desc->dtype[i], &typesize);
+        desc->arg[i].localarg = va_arg(ap, VIRT_ADDR);
+    }
 
-            void *pmem = malloc(desc->quantity[i] * typesize);
+    //! the addresses of the arguments, before the values passed by copy replace them
+    VIRT_ADDR regions[MAX_TORC_ARGS];
+    for (int i = 0; dataflow && (i < narg); i++)
+    {
+        regions[i] = desc->arg[i].localarg;
+    }
 
-            VIRT_ADDR addr = va_arg(ap, VIRT_ADDR);
+    _torc_task_copyin(desc);
 
-            memcpy(pmem, (void *)addr, desc->quantity[i] * typesize);
+    //! in dataflow mode a task that depends on unfinished tasks is held back
+    if (dataflow && _torc_dataflow_register(desc, queue, regions))
+    {
+        return;
+    }
 
-            desc->localarg[i] = (INT64)pmem;
-        }
-        else
-        {
-            //! pointer (C: PTR, VAL)
-            desc->localarg[i] = va_arg(ap, VIRT_ADDR);
-        }
+    if (run_inline)
+    {
+        torc_task_run_inline(self, desc);
+        return;
     }
 
     if (queue == -1)
@@ -332,6 +432,110 @@ void torc_task(int queue, void (*work)(), int narg, ...)
     }
 }
 
+/**
+ * @brief Execute the task  
+ * 
+ * @param queue 
+ * @param work   Callable object to execute in the thread
+ * @param narg   Number of arguments of this callable object
+ * @param ... 
+ */
+void torc_task(int queue, void (*work)(), int narg, ...)
+{
+    va_list ap;
+    va_start(ap, narg);
+
+    torc_task_va(queue, NULL, work, narg, ap);
+
+    va_end(ap);
+}
+
+/**
+ * @brief Execute the task and return a handle to wait for it alone
+ * The task also counts as a child for torc_waitall
+ *
+ * @param queue
+ * @param work   Callable object to execute in the thread
+ * @param narg   Number of arguments of this callable object
+ * @param ...
+ * @return torc_handle_t handle, released by torc_wait or by a successful torc_test
+ */
+torc_handle_t torc_task_future(int queue, void (*work)(), int narg, ...)
+{
+    torc_future_t *future = (torc_future_t *)calloc(1, sizeof(torc_future_t));
+
+    atomic_init(&future->done, 0);
+    future->vp_id = _torc_self()->vp_id;
+    future->handle = 1;
+
+    va_list ap;
+    va_start(ap, narg);
+
+    torc_task_va(queue, future, work, narg, ap);
+
+    va_end(ap);
+
+    return future;
+}
+
+/**
+ * @brief Wait for the task of a handle, executing other tasks meanwhile
+ * The results of the task are in place on return
+ *
+ * @param handle handle of torc_task_future, set to NULL
+ */
+void torc_wait(torc_handle_t *handle)
+{
+    torc_future_t *future = *handle;
+
+    if (future == NULL)
+    {
+        return;
+    }
+
+    if (!atomic_load_explicit(&future->done, memory_order_acquire))
+    {
+        //! the task may be waiting in the batches of remote enqueues
+        torc_aggr_flush(0);
+
+        while (!atomic_load_explicit(&future->done, memory_order_acquire))
+        {
+            _torc_scheduler_loop(1);
+        }
+    }
+
+    free(future);
+    *handle = NULL;
+}
+
+/**
+ * @brief Check whether the task of a handle has finished, without blocking
+ *
+ * @param handle handle of torc_task_future, set to NULL once the task has finished
+ * @return int 1 if the task has finished (its results are in place)
+ */
+int torc_test(torc_handle_t *handle)
+{
+    torc_future_t *future = *handle;
+
+    if (future == NULL)
+    {
+        return 1;
+    }
+
+    if (!atomic_load_explicit(&future->done, memory_order_acquire))
+    {
+        torc_aggr_flush(1);
+
+        return 0;
+    }
+
+    free(future);
+    *handle = NULL;
+
+    return 1;
+}
+
 void torc_task_ex(int queue, int invisible, void (*work)(), int narg, ...)
 {
     if (narg > MAX_TORC_ARGS)
@@ -342,20 +546,15 @@ void torc_task_ex(int queue, int invisible, void (*work)(), int narg, ...)
     torc_t *self = _torc_self();
 
     //! Check if rte_init has been called
-    _lock_acquire(&self->lock);
-    if (self->ndep == 0)
-    {
-        self->ndep = 1;
-    }
-    _lock_release(&self->lock);
+    _torc_depinit(self);
 
     _torc_depadd(self, 1);
 
-    torc_t *desc = _torc_get_reused_desc();
+    torc_t *desc = _torc_get_reused_desc(narg);
 
     {
-        _lock_init(&desc->lock);
         desc->parent = self;
+        _torc_group_join(self, desc);
         desc->vp_id = -1;
         _torc_set_work_routine(desc, work);
         desc->work_id = -1;
@@ -387,66 +586,66 @@ void torc_task_ex(int queue, int invisible, void (*work)(), int narg, ...)
 
     for (int i = 0; i < narg; i++)
     {
-        desc->quantity[i] = va_arg(ap, int);
-        desc->dtype[i] = va_arg(ap, MPI_Datatype);
-        desc->btype[i] = _torc_mpi2b_type(desc->dtype[i]);
-        desc->callway[i] = va_arg(ap, int);
+        desc->arg[i].quantity = va_arg(ap, int);
+        desc->arg[i].dtype = va_arg(ap, MPI_Datatype);
+        desc->arg[i].btype = _torc_mpi2b_type(desc->arg[i].dtype);
+        desc->arg[i].callway = va_arg(ap, int);
 
-        if ((desc->callway[i] == CALL_BY_COP) && (desc->quantity[i] > 1))
+        if ((desc->arg[i].callway == CALL_BY_COP) && (desc->arg[i].quantity > 1))
         {
-            desc->callway[i] = CALL_BY_COP2;
+            desc->arg[i].callway = CALL_BY_COP2;
         }
 
 #if DEBUG
-        printf("ARG %d : Q = %d, T = %d, C = %x O\n", i, desc->quantity[i], desc->dtype[i], desc->callway[i]);
+        printf("ARG %d : Q = %d, T = %d, C = %x O\n", i, desc->arg[i].quantity, desc->arg[i].dtype, desc->arg[i].callway);
         fflush(0);
 #endif
     }
 
     for (int i = 0; i < narg; i++)
     {
-        if (desc->quantity[i] == 0)
+        if (desc->arg[i].quantity == 0)
         {
             VIRT_ADDR dummy;
             dummy = va_arg(ap, VIRT_ADDR);
             continue;
         }
 
-        if (desc->callway[i] == CALL_BY_COP)
+        if (desc->arg[i].callway == CALL_BY_COP)
         {
             int typesize;
-            MPI_Type_size(desc->dtype[i], &typesize);
+            MPI_Type_size(desc->arg[i].dtype, &typesize);
 
             switch (typesize)
             {
             case 4:
-                desc->localarg[i] = *va_arg(ap, INT32 *);
+                desc->arg[i].localarg = *va_arg(ap, INT32 *);
                 break;
             case 8:
-                desc->localarg[i] = *va_arg(ap, INT64 *);
+                desc->arg[i].localarg = *va_arg(ap, INT64 *);
                 break;
             default:
                 Error("Type size is not 4 or 8!");
                 break;
             }
         }
-        else if (desc->callway[i] == CALL_BY_COP2)
+        else if (desc->arg[i].callway == CALL_BY_COP2)
         {
             int typesize;
-            MPI_Type_size(desc->dtype[i], &typesize);
+            MPI_Type_size(desc->arg[i].dtype, &typesize);
 
-            void *pmem = malloc(desc->quantity[i] * typesize);
+            void *pmem = malloc(desc->arg[i].quantity * typesize);
 
             VIRT_ADDR addr = va_arg(ap, VIRT_ADDR);
 
-            memcpy(pmem, (void *)addr, desc->quantity[i] * typesize);
+            memcpy(pmem, (void *)addr, desc->arg[i].quantity * typesize);
 
-            desc->localarg[i] = (INT64)pmem;
+            desc->arg[i].localarg = (INT64)pmem;
         }
         else
         {
             //! pointer (C: PTR, VAL)
-            desc->localarg[i] = va_arg(ap, VIRT_ADDR);
+            desc->arg[i].localarg = va_arg(ap, VIRT_ADDR);
         }
     }
 
@@ -472,20 +671,15 @@ void torc_task_direct(int queue, void (*work)(), int narg, ...)
     torc_t *self = _torc_self();
 
     /* Check if rte_init has been called */
-    _lock_acquire(&self->lock);
-    if (self->ndep == 0)
-    {
-        self->ndep = 1;
-    }
-    _lock_release(&self->lock);
+    _torc_depinit(self);
 
     _torc_depadd(self, 1);
 
-    torc_t *desc = _torc_get_reused_desc();
+    torc_t *desc = _torc_get_reused_desc(narg);
 
     {
-        _lock_init(&desc->lock);
         desc->parent = self;
+        _torc_group_join(self, desc);
         desc->vp_id = -1;
         _torc_set_work_routine(desc, work);
         desc->work_id = -1;
@@ -504,66 +698,66 @@ void torc_task_direct(int queue, void (*work)(), int narg, ...)
 
     for (int i = 0; i < narg; i++)
     {
-        desc->quantity[i] = va_arg(ap, int);
-        desc->dtype[i] = va_arg(ap, MPI_Datatype);
-        desc->btype[i] = _torc_mpi2b_type(desc->dtype[i]);
-        desc->callway[i] = va_arg(ap, int);
+        desc->arg[i].quantity = va_arg(ap, int);
+        desc->arg[i].dtype = va_arg(ap, MPI_Datatype);
+        desc->arg[i].btype = _torc_mpi2b_type(desc->arg[i].dtype);
+        desc->arg[i].callway = va_arg(ap, int);
 
-        if ((desc->callway[i] == CALL_BY_COP) && (desc->quantity[i] > 1))
+        if ((desc->arg[i].callway == CALL_BY_COP) && (desc->arg[i].quantity > 1))
         {
-            desc->callway[i] = CALL_BY_COP2;
+            desc->arg[i].callway = CALL_BY_COP2;
         }
 
 #if DEBUG
-        printf("ARG %d : Q = %d, T = %d, C = %x O\n", i, desc->quantity[i], desc->dtype[i], desc->callway[i]);
+        printf("ARG %d : Q = %d, T = %d, C = %x O\n", i, desc->arg[i].quantity, desc->arg[i].dtype, desc->arg[i].callway);
         fflush(0);
 #endif
     }
 
     for (int i = 0; i < narg; i++)
     {
-        if (desc->quantity[i] == 0)
+        if (desc->arg[i].quantity == 0)
         {
             VIRT_ADDR dummy;
             dummy = va_arg(ap, VIRT_ADDR);
             continue;
         }
 
-        if (desc->callway[i] == CALL_BY_COP)
+        if (desc->arg[i].callway == CALL_BY_COP)
         {
             int typesize;
-            MPI_Type_size(desc->dtype[i], &typesize);
+            MPI_Type_size(desc->arg[i].dtype, &typesize);
 
             switch (typesize)
             {
             case 4:
-                desc->localarg[i] = *va_arg(ap, INT32 *);
+                desc->arg[i].localarg = *va_arg(ap, INT32 *);
                 break;
             case 8:
-                desc->localarg[i] = *va_arg(ap, INT64 *);
+                desc->arg[i].localarg = *va_arg(ap, INT64 *);
                 break;
             default:
                 Error("Type size is not 4 or 8!");
                 break;
             }
         }
-        else if (desc->callway[i] == CALL_BY_COP2)
+        else if (desc->arg[i].callway == CALL_BY_COP2)
         {
             int typesize;
-            MPI_Type_size(desc->dtype[i], &typesize);
+            MPI_Type_size(desc->arg[i].dtype, &typesize);
 
-            void *pmem = malloc(desc->quantity[i] * typesize);
+            void *pmem = malloc(desc->arg[i].quantity * typesize);
 
             VIRT_ADDR addr = va_arg(ap, VIRT_ADDR);
 
-            memcpy(pmem, (void *)addr, desc->quantity[i] * typesize);
+            memcpy(pmem, (void *)addr, desc->arg[i].quantity * typesize);
 
-            desc->localarg[i] = (INT64)pmem;
+            desc->arg[i].localarg = (INT64)pmem;
         }
         else
         {
             //! pointer (C: PTR, VAL)
-            desc->localarg[i] = va_arg(ap, VIRT_ADDR);
+            desc->arg[i].localarg = va_arg(ap, VIRT_ADDR);
         }
     }
 
@@ -629,12 +823,16 @@ int torc_i_num_workers()
 
 /**
  * @brief  Get the virtual processor ID
+ * Threads without a virtual processor (the server thread, which runs the
+ * direct tasks) report worker 0
  * 
  * @return int 
  */
 int torc_i_worker_id()
 {
-    return _torc_get_vpid();
+    long const vp = _torc_get_vpid();
+
+    return (vp < 0) ? 0 : (int)vp;
 }
 
 /**
@@ -654,7 +852,7 @@ int torc_num_workers()
  */
 int torc_worker_id()
 {
-    return (torc_num_nodes() > 1) ? local_thread_id_to_global_thread_id(_torc_get_vpid()) : _torc_get_vpid();
+    return (torc_num_nodes() > 1) ? local_thread_id_to_global_thread_id(torc_i_worker_id()) : torc_i_worker_id();
 }
 
 /**
@@ -724,11 +922,11 @@ void *torc_getarg_addr(int arg)
 
     if (torc_node_id() == self->homenode)
     {
-        return (self->callway[arg] == CALL_BY_COP) ? &(self->localarg[arg]) : ((void *)self->localarg[arg]);
+        return (self->arg[arg].callway == CALL_BY_COP) ? &(self->arg[arg].localarg) : ((void *)self->arg[arg].localarg);
     }
     else
     {
-        return (self->callway[arg] == CALL_BY_COP) ? &(self->temparg[arg]) : ((void *)self->temparg[arg]);
+        return (self->arg[arg].callway == CALL_BY_COP) ? &(self->arg[arg].temparg) : ((void *)self->arg[arg].temparg);
     }
 }
 
@@ -751,7 +949,7 @@ int torc_get_num_args()
  */
 int torc_getarg_callway(int arg)
 {
-    return _torc_self()->callway[arg];
+    return _torc_self()->arg[arg].callway;
 }
 
 /**
@@ -762,7 +960,7 @@ int torc_getarg_callway(int arg)
  */
 int torc_getarg_count(int arg)
 {
-    return _torc_self()->quantity[arg];
+    return _torc_self()->arg[arg].quantity;
 }
 
 /**
@@ -775,7 +973,7 @@ int torc_getarg_size(int arg)
 {
     int typesize;
 
-    MPI_Type_size(_torc_self()->dtype[arg], &typesize);
+    MPI_Type_size(_torc_self()->arg[arg].dtype, &typesize);
 
     return typesize;
 }
@@ -817,20 +1015,15 @@ void F77_FUNC_(torc_createf, TORC_CREATEF)(int *pqueue, void (*work)(), int *pna
     torc_t *self = _torc_self();
 
     //! Check if rte_init has been called
-    _lock_acquire(&self->lock);
-    if (self->ndep == 0)
-    {
-        self->ndep = 1;
-    }
-    _lock_release(&self->lock);
+    _torc_depinit(self);
 
     _torc_depadd(self, 1);
 
-    torc_t *desc = _torc_get_reused_desc();
+    torc_t *desc = _torc_get_reused_desc(narg);
 
     {
-        _lock_init(&desc->lock);
         desc->parent = self;
+        _torc_group_join(self, desc);
         desc->vp_id = -1;
         _torc_set_work_routine(desc, work);
         desc->work_id = -1;
@@ -862,60 +1055,60 @@ void F77_FUNC_(torc_createf, TORC_CREATEF)(int *pqueue, void (*work)(), int *pna
 
     for (int i = 0; i < narg; i++)
     {
-        desc->quantity[i] = *va_arg(ap, int *);
+        desc->arg[i].quantity = *va_arg(ap, int *);
         MPI_Fint dt = *va_arg(ap, MPI_Fint *);
-        desc->dtype[i] = MPI_Type_f2c(dt);
-        desc->btype[i] = _torc_mpi2b_type(desc->dtype[i]);
-        desc->callway[i] = *va_arg(ap, int *);
+        desc->arg[i].dtype = MPI_Type_f2c(dt);
+        desc->arg[i].btype = _torc_mpi2b_type(desc->arg[i].dtype);
+        desc->arg[i].callway = *va_arg(ap, int *);
 
-        if ((desc->callway[i] == CALL_BY_COP) && (desc->quantity[i] > 1))
+        if ((desc->arg[i].callway == CALL_BY_COP) && (desc->arg[i].quantity > 1))
         {
-            desc->callway[i] = CALL_BY_COP2;
+            desc->arg[i].callway = CALL_BY_COP2;
         }
 
 #if DEBUG
-        printf("ARG %d : Q = %d, T = %d, C = %x O\n", i, desc->quantity[i], desc->dtype[i], desc->callway[i]);
+        printf("ARG %d : Q = %d, T = %d, C = %x O\n", i, desc->arg[i].quantity, desc->arg[i].dtype, desc->arg[i].callway);
         fflush(0);
 #endif
     }
 
     for (int i = 0; i < narg; i++)
     {
-        if (desc->callway[i] == CALL_BY_COP)
+        if (desc->arg[i].callway == CALL_BY_COP)
         {
             int typesize;
-            MPI_Type_size(desc->dtype[i], &typesize);
+            MPI_Type_size(desc->arg[i].dtype, &typesize);
 
             switch (typesize)
             {
             case 4:
-                desc->localarg[i] = *va_arg(ap, INT32 *);
+                desc->arg[i].localarg = *va_arg(ap, INT32 *);
                 break;
             case 8:
-                desc->localarg[i] = *va_arg(ap, INT64 *);
+                desc->arg[i].localarg = *va_arg(ap, INT64 *);
                 break;
             default:
                 Error("Type size is not 4 or 8!");
                 break;
             }
         }
-        else if (desc->callway[i] == CALL_BY_COP2)
+        else if (desc->arg[i].callway == CALL_BY_COP2)
         {
             int typesize;
-            MPI_Type_size(desc->dtype[i], &typesize);
+            MPI_Type_size(desc->arg[i].dtype, &typesize);
 
-            void *pmem = malloc(desc->quantity[i] * typesize);
+            void *pmem = malloc(desc->arg[i].quantity * typesize);
 
             VIRT_ADDR addr = va_arg(ap, VIRT_ADDR);
 
-            memcpy(pmem, (void *)addr, desc->quantity[i] * typesize);
+            memcpy(pmem, (void *)addr, desc->arg[i].quantity * typesize);
 
-            desc->localarg[i] = (INT64)pmem;
+            desc->arg[i].localarg = (INT64)pmem;
         }
         else
         {
             //! pointer (C: PTR, VAL)
-            desc->localarg[i] = va_arg(ap, VIRT_ADDR);
+            desc->arg[i].localarg = va_arg(ap, VIRT_ADDR);
         }
     }
 
@@ -941,22 +1134,17 @@ void F77_FUNC_(torc_taskf, TORC_TASKF)(void (*work)(), int *ptype, int *pnarg, .
     torc_t *self = _torc_self();
 
     /* Check if rte_init has been called */
-    _lock_acquire(&self->lock);
-    if (self->ndep == 0)
-    {
-        self->ndep = 1;
-    }
-    _lock_release(&self->lock);
+    _torc_depinit(self);
 
     _torc_depadd(self, 1);
 
     int type = *ptype;
 
-    torc_t *desc = _torc_get_reused_desc();
+    torc_t *desc = _torc_get_reused_desc(narg);
 
     {
-        _lock_init(&desc->lock);
         desc->parent = self;
+        _torc_group_join(self, desc);
         desc->vp_id = -1;
         _torc_set_work_routine(desc, work);
         desc->work_id = -1;
@@ -988,60 +1176,60 @@ void F77_FUNC_(torc_taskf, TORC_TASKF)(void (*work)(), int *ptype, int *pnarg, .
 
     for (int i = 0; i < narg; i++)
     {
-        desc->quantity[i] = *va_arg(ap, int *);
+        desc->arg[i].quantity = *va_arg(ap, int *);
         MPI_Fint dt = *va_arg(ap, MPI_Fint *);
-        desc->dtype[i] = MPI_Type_f2c(dt);
-        desc->btype[i] = _torc_mpi2b_type(desc->dtype[i]);
-        desc->callway[i] = *va_arg(ap, int *);
+        desc->arg[i].dtype = MPI_Type_f2c(dt);
+        desc->arg[i].btype = _torc_mpi2b_type(desc->arg[i].dtype);
+        desc->arg[i].callway = *va_arg(ap, int *);
 
-        if ((desc->callway[i] == CALL_BY_COP) && (desc->quantity[i] > 1))
+        if ((desc->arg[i].callway == CALL_BY_COP) && (desc->arg[i].quantity > 1))
         {
-            desc->callway[i] = CALL_BY_COP2;
+            desc->arg[i].callway = CALL_BY_COP2;
         }
 
 #if DEBUG
-        printf("ARG %d : Q = %d, T = %d, C = %x O\n", i, desc->quantity[i], desc->dtype[i], desc->callway[i]);
+        printf("ARG %d : Q = %d, T = %d, C = %x O\n", i, desc->arg[i].quantity, desc->arg[i].dtype, desc->arg[i].callway);
         fflush(0);
 #endif
     }
 
     for (int i = 0; i < narg; i++)
     {
-        if (desc->callway[i] == CALL_BY_COP)
+        if (desc->arg[i].callway == CALL_BY_COP)
         {
             int typesize;
-            MPI_Type_size(desc->dtype[i], &typesize);
+            MPI_Type_size(desc->arg[i].dtype, &typesize);
 
             switch (typesize)
             {
             case 4:
-                desc->localarg[i] = *va_arg(ap, INT32 *);
+                desc->arg[i].localarg = *va_arg(ap, INT32 *);
                 break;
             case 8:
-                desc->localarg[i] = *va_arg(ap, INT64 *);
+                desc->arg[i].localarg = *va_arg(ap, INT64 *);
                 break;
             default:
                 Error("Type size is not 4 or 8!");
                 break;
             }
         }
-        else if (desc->callway[i] == CALL_BY_COP2)
+        else if (desc->arg[i].callway == CALL_BY_COP2)
         {
             int typesize;
-            MPI_Type_size(desc->dtype[i], &typesize);
+            MPI_Type_size(desc->arg[i].dtype, &typesize);
 
             VIRT_ADDR addr = va_arg(ap, VIRT_ADDR);
             
-            void *pmem = malloc(desc->quantity[i] * typesize);
+            void *pmem = malloc(desc->arg[i].quantity * typesize);
             
-            memcpy(pmem, (void *)addr, desc->quantity[i] * typesize);
+            memcpy(pmem, (void *)addr, desc->arg[i].quantity * typesize);
             
-            desc->localarg[i] = (INT64)pmem;
+            desc->arg[i].localarg = (INT64)pmem;
         }
         else
         {
             //! pointer (C: PTR, VAL)
-            desc->localarg[i] = va_arg(ap, VIRT_ADDR);
+            desc->arg[i].localarg = va_arg(ap, VIRT_ADDR);
         }
     }
 
@@ -0,0 +1,588 @@
+/*
+ *  torc_affinity.c
+ *  TORC_Lite
+ *
+ *  Created by Panagiotis Hadjidoukas on 1/1/14.
+ *  Copyright 2014 ETH Zurich. All rights reserved.
+ *
+ */
+#define _GNU_SOURCE
+#include <torc_internal.h>
+#include <torc.h>
+#include <dirent.h>
+
+/**
+ * \defgroup Affinity
+ * TORC_AFFINITY pins the workers and the server thread of a node to the
+ * processors of its host, read from /sys/devices/system/cpu:
+ * - compact: consecutive hardware threads, filling a core, a package and a
+ *   NUMA node before moving to the next one;
+ * - scatter: one hardware thread per core, round robin over the NUMA nodes,
+ *   before the second hardware thread of any core is used;
+ * - a list of processors such as 0,2,4-7, used in this order.
+ * The nodes that share a host take consecutive slots of the order: a worker
+ * per slot, then one for the server thread if the host has processors left
+ * (otherwise it may run on any processor of the workers of its node). If the
+ * node has been bound to a subset of the processors (e.g. by mpirun), only
+ * that subset is used and it is not shared. The placement is reported at
+ * startup.
+ *
+ * A pinned worker replaces the array of its deque by one that it allocates
+ * and touches itself, so that the array is placed on its NUMA node; the
+ * descriptor slabs of its cache are already allocated by the worker.
+ */
+/**@{*/
+
+//! Longest explicit list of processors
+#define TORC_AFFINITY_MAX_LIST 1024
+
+/**
+ * @brief A processor of the host
+ *
+ */
+typedef struct
+{
+    int cpu;
+    //! NUMA node
+    int numa;
+    int package;
+    int core;
+    //! hardware thread of the core
+    int smt;
+    //! rank of the core within its NUMA node
+    int rank;
+} torc_cpu_t;
+
+static struct
+{
+    //! explicit list of TORC_AFFINITY
+    int list[TORC_AFFINITY_MAX_LIST];
+    int nlist;
+    //! usable processors, in placement order
+    torc_cpu_t *cpus;
+    int ncpus;
+    //! processor of each worker, -1: not pinned
+    int worker_cpu[MAX_NVPS];
+    //! processor of the server thread, -1: any processor of the workers
+    int server_cpu;
+} aff;
+
+static char const *affinity_names[] = {"none", "compact", "scatter", "list"};
+
+/**
+ * @brief Parse a list of processors such as 0,2,4-7
+ *
+ * @return int number of processors, -1 if the list is malformed
+ */
+static int parse_list(char const *s, int *list, int max)
+{
+    int n = 0;
+
+    while (*s != '\0')
+    {
+        char *end;
+        long const first = strtol(s, &end, 10);
+        if ((end == s) || (first < 0))
+        {
+            return -1;
+        }
+
+        long last = first;
+        s = end;
+        if (*s == '-')
+        {
+            last = strtol(s + 1, &end, 10);
+            if ((end == s + 1) || (last < first))
+            {
+                return -1;
+            }
+            s = end;
+        }
+
+        for (long c = first; (c <= last) && (n < max); c++)
+        {
+            list[n++] = (int)c;
+        }
+
+        if (*s == ',')
+        {
+            s++;
+        }
+        else if ((*s != '\0') && (*s != '\n'))
+        {
+            return -1;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    return n;
+}
+
+/**
+ * @brief Parse the placement policy of TORC_AFFINITY
+ * An explicit list is kept for _torc_affinity_init
+ *
+ * @param s name or list of processors
+ * @return int policy or -1 if unknown
+ */
+int _torc_affinity_policy(char const *s)
+{
+    for (int p = TORC_AFFINITY_NONE; p < TORC_AFFINITY_LIST; p++)
+    {
+        if (strcmp(s, affinity_names[p]) == 0)
+        {
+            return p;
+        }
+    }
+
+    int const n = parse_list(s, aff.list, TORC_AFFINITY_MAX_LIST);
+    if (n <= 0)
+    {
+        return -1;
+    }
+
+    aff.nlist = n;
+    return TORC_AFFINITY_LIST;
+}
+
+/**
+ * @brief Read an integer from a file of the sysfs
+ *
+ * @return int the value or def
+ */
+static int read_int(char const *path, int def)
+{
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+    {
+        return def;
+    }
+
+    int val;
+    if (fscanf(fp, "%d", &val) != 1)
+    {
+        val = def;
+    }
+    fclose(fp);
+
+    return val;
+}
+
+/**
+ * @brief Read a list of processors from a file of the sysfs
+ *
+ * @return int number of processors, 0 if not available
+ */
+static int read_list(char const *path, int *list, int max)
+{
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+    {
+        return 0;
+    }
+
+    char line[4096];
+    int n = 0;
+    if (fgets(line, sizeof(line), fp) != NULL)
+    {
+        n = parse_list(line, list, max);
+    }
+    fclose(fp);
+
+    return (n > 0) ? n : 0;
+}
+
+/**
+ * @brief Set the NUMA node of the processors from /sys/devices/system/node
+ *
+ */
+static void read_numa(torc_cpu_t *cpus, int ncpus)
+{
+    DIR *dir = opendir("/sys/devices/system/node");
+    if (dir == NULL)
+    {
+        return;
+    }
+
+    struct dirent *e;
+    int list[TORC_AFFINITY_MAX_LIST];
+
+    while ((e = readdir(dir)) != NULL)
+    {
+        int numa;
+        if (sscanf(e->d_name, "node%d", &numa) != 1)
+        {
+            continue;
+        }
+
+        char path[256];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", numa);
+
+        int const n = read_list(path, list, TORC_AFFINITY_MAX_LIST);
+        for (int k = 0; k < n; k++)
+        {
+            for (int i = 0; i < ncpus; i++)
+            {
+                if (cpus[i].cpu == list[k])
+                {
+                    cpus[i].numa = numa;
+                }
+            }
+        }
+    }
+
+    closedir(dir);
+}
+
+static int cmp_compact(void const *a, void const *b)
+{
+    torc_cpu_t const *x = (torc_cpu_t const *)a;
+    torc_cpu_t const *y = (torc_cpu_t const *)b;
+
+    if (x->numa != y->numa)
+        return x->numa - y->numa;
+    if (x->package != y->package)
+        return x->package - y->package;
+    if (x->core != y->core)
+        return x->core - y->core;
+    if (x->smt != y->smt)
+        return x->smt - y->smt;
+    return x->cpu - y->cpu;
+}
+
+static int cmp_scatter(void const *a, void const *b)
+{
+    torc_cpu_t const *x = (torc_cpu_t const *)a;
+    torc_cpu_t const *y = (torc_cpu_t const *)b;
+
+    if (x->smt != y->smt)
+        return x->smt - y->smt;
+    if (x->rank != y->rank)
+        return x->rank - y->rank;
+    return cmp_compact(a, b);
+}
+
+/**
+ * @brief Read the processors that the node may use and their topology
+ *
+ * @param shared set to 1 if the node may use all the online processors of its host
+ * @return int number of processors in aff.cpus
+ */
+static int read_topology(int *shared)
+{
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+    {
+        return 0;
+    }
+
+    int online[TORC_AFFINITY_MAX_LIST];
+    int nonline = read_list("/sys/devices/system/cpu/online", online, TORC_AFFINITY_MAX_LIST);
+    if (nonline == 0)
+    {
+        //! no sysfs: the allowed processors, without topology
+        for (int c = 0; (c < CPU_SETSIZE) && (nonline < TORC_AFFINITY_MAX_LIST); c++)
+        {
+            if (CPU_ISSET(c, &allowed))
+            {
+                online[nonline++] = c;
+            }
+        }
+    }
+
+    aff.cpus = (torc_cpu_t *)calloc(nonline, sizeof(torc_cpu_t));
+
+    int n = 0;
+    for (int k = 0; k < nonline; k++)
+    {
+        int const c = online[k];
+        if ((c >= CPU_SETSIZE) || !CPU_ISSET(c, &allowed))
+        {
+            continue;
+        }
+
+        torc_cpu_t *p = &aff.cpus[n++];
+        char path[256];
+
+        p->cpu = c;
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", c);
+        p->package = read_int(path, 0);
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_id", c);
+        p->core = read_int(path, c);
+
+        //! the position of the processor among the hardware threads of its core
+        int siblings[TORC_AFFINITY_MAX_LIST];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", c);
+        int const ns = read_list(path, siblings, TORC_AFFINITY_MAX_LIST);
+        for (int s = 0; s < ns; s++)
+        {
+            if (siblings[s] < c)
+            {
+                p->smt++;
+            }
+        }
+    }
+
+    *shared = (n == nonline);
+
+    read_numa(aff.cpus, n);
+
+    //! rank of each core within its NUMA node, in compact order
+    qsort(aff.cpus, n, sizeof(torc_cpu_t), cmp_compact);
+    for (int i = 0, rank = 0; i < n; i++)
+    {
+        if ((i > 0) && (aff.cpus[i].numa != aff.cpus[i - 1].numa))
+        {
+            rank = 0;
+        }
+        else if ((i > 0) && ((aff.cpus[i].package != aff.cpus[i - 1].package) || (aff.cpus[i].core != aff.cpus[i - 1].core)))
+        {
+            rank++;
+        }
+        aff.cpus[i].rank = rank;
+    }
+
+    return n;
+}
+
+/**
+ * @brief The position of the node among the nodes of its host, collective over comm_out
+ *
+ * @param count set to the number of nodes of the host
+ * @return int
+ */
+static int host_position(int *count)
+{
+    char name[MPI_MAX_PROCESSOR_NAME];
+    int namelen;
+
+    memset(name, 0, sizeof(name));
+    MPI_Get_processor_name(name, &namelen);
+
+    char *names = (char *)calloc(torc_num_nodes(), MPI_MAX_PROCESSOR_NAME);
+
+    enter_comm_cs();
+    MPI_Allgather(name, MPI_MAX_PROCESSOR_NAME, MPI_CHAR, names, MPI_MAX_PROCESSOR_NAME, MPI_CHAR, comm_out);
+    leave_comm_cs();
+
+    int pos = 0;
+    *count = 0;
+    for (int i = 0; i < torc_num_nodes(); i++)
+    {
+        if (strncmp(names + i * MPI_MAX_PROCESSOR_NAME, name, MPI_MAX_PROCESSOR_NAME) == 0)
+        {
+            if (i < torc_node_id())
+            {
+                pos++;
+            }
+            (*count)++;
+        }
+    }
+
+    free(names);
+
+    return pos;
+}
+
+/**
+ * @brief Find the processor of each thread of the node and pin the calling (main) thread
+ * Collective over comm_out, called before the workers and the server thread are created
+ *
+ */
+void _torc_affinity_init()
+{
+    for (int i = 0; i < MAX_NVPS; i++)
+    {
+        aff.worker_cpu[i] = -1;
+    }
+    aff.server_cpu = -1;
+
+    if (affinity == TORC_AFFINITY_NONE)
+    {
+        return;
+    }
+
+    int shared;
+    int nhost;
+    int const pos = host_position(&nhost);
+
+    aff.ncpus = read_topology(&shared);
+    if (aff.ncpus == 0)
+    {
+        Warning1("TORC_AFFINITY: %s, the threads are not pinned", "no processors found");
+        return;
+    }
+
+    if (affinity == TORC_AFFINITY_SCATTER)
+    {
+        qsort(aff.cpus, aff.ncpus, sizeof(torc_cpu_t), cmp_scatter);
+    }
+
+    //! processors of the placement order
+    int *order = (int *)malloc(((affinity == TORC_AFFINITY_LIST) ? aff.nlist : aff.ncpus) * sizeof(int));
+    int norder = 0;
+
+    if (affinity == TORC_AFFINITY_LIST)
+    {
+        for (int k = 0; k < aff.nlist; k++)
+        {
+            for (int i = 0; i < aff.ncpus; i++)
+            {
+                if (aff.cpus[i].cpu == aff.list[k])
+                {
+                    order[norder++] = aff.list[k];
+                    break;
+                }
+            }
+        }
+    }
+    else
+    {
+        for (int i = 0; i < aff.ncpus; i++)
+        {
+            order[norder++] = aff.cpus[i].cpu;
+        }
+    }
+
+    if (norder == 0)
+    {
+        Warning1("TORC_AFFINITY: %s, the threads are not pinned", "no usable processor in the list");
+        free(order);
+        return;
+    }
+
+    //! slots of the node: its workers and the server thread
+    int const nslots = kthreads + ((torc_num_nodes() > 1) ? 1 : 0);
+    int const first = shared ? pos * nslots : 0;
+    int const used = shared ? nhost * nslots : nslots;
+
+    for (unsigned int i = 0; i < kthreads; i++)
+    {
+        aff.worker_cpu[i] = order[(first + i) % norder];
+    }
+
+    if ((torc_num_nodes() > 1) && (used <= norder))
+    {
+        aff.server_cpu = order[first + kthreads];
+    }
+
+    free(order);
+
+    if (used > norder)
+    {
+        Warning1("TORC_AFFINITY: more threads than processors (%d), some processors are shared", norder);
+    }
+
+    //! the main thread is worker 0
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(aff.worker_cpu[0], &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+
+    rq_localize(0);
+
+    _torc_affinity_report();
+}
+
+/**
+ * @brief Set the processors of a thread that is about to be created
+ *
+ * @param attr attributes of the new thread
+ * @param vp   worker or MAX_NVPS for the server thread
+ */
+void _torc_affinity_attr(pthread_attr_t *attr, long vp)
+{
+    if (affinity == TORC_AFFINITY_NONE)
+    {
+        return;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    if (vp < (long)kthreads)
+    {
+        if (aff.worker_cpu[vp] < 0)
+        {
+            return;
+        }
+        CPU_SET(aff.worker_cpu[vp], &set);
+    }
+    else if (aff.server_cpu >= 0)
+    {
+        CPU_SET(aff.server_cpu, &set);
+    }
+    else
+    {
+        for (unsigned int i = 0; i < kthreads; i++)
+        {
+            if (aff.worker_cpu[i] >= 0)
+            {
+                CPU_SET(aff.worker_cpu[i], &set);
+            }
+        }
+    }
+
+    if (CPU_COUNT(&set) > 0)
+    {
+        pthread_attr_setaffinity_np(attr, sizeof(set), &set);
+    }
+}
+
+/**
+ * @brief Whether the workers are pinned
+ *
+ */
+int _torc_affinity_pinned()
+{
+    return (affinity != TORC_AFFINITY_NONE) && (aff.worker_cpu[0] >= 0);
+}
+
+/**
+ * @brief Print the placement of the threads of the node
+ *
+ */
+void _torc_affinity_report()
+{
+    char line[64 * MAX_NVPS];
+    int len = 0;
+
+    for (unsigned int i = 0; i < kthreads; i++)
+    {
+        torc_cpu_t const *p = NULL;
+        for (int k = 0; k < aff.ncpus; k++)
+        {
+            if (aff.cpus[k].cpu == aff.worker_cpu[i])
+            {
+                p = &aff.cpus[k];
+            }
+        }
+
+        if (p != NULL)
+        {
+            len += snprintf(line + len, sizeof(line) - len, " %u:cpu%d(numa %d, core %d.%d)", i, p->cpu, p->numa,
+                            p->package, p->core);
+        }
+    }
+
+    if (torc_num_nodes() > 1)
+    {
+        if (aff.server_cpu >= 0)
+        {
+            snprintf(line + len, sizeof(line) - len, " server:cpu%d", aff.server_cpu);
+        }
+        else
+        {
+            snprintf(line + len, sizeof(line) - len, " server:workers");
+        }
+    }
+
+    printf("TORC_LITE ... rank %d affinity %s:%s\n", torc_node_id(), affinity_names[affinity], line);
+    fflush(0);
+}
+
+/**@}*/
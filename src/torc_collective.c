@@ -0,0 +1,992 @@
+/*
+ *  torc_collective.c
+ *  TORC_Lite
+ *
+ *  Created by Panagiotis Hadjidoukas on 1/1/14.
+ *  Copyright 2014 ETH Zurich. All rights reserved.
+ *
+ */
+#include <torc_internal.h>
+#include <torc.h>
+
+/**
+ * \defgroup Collective operations
+ * Collectives are started by any thread of one node while the workers of the
+ * other nodes keep running tasks: the server threads take part in them, the
+ * progress engine completes their transfers.
+ *
+ * A broadcast follows a binomial tree rooted at the calling node. Every node
+ * forwards the header (TORC_BCAST) to its children, receives the buffer from
+ * its parent in segments of TORC_BCAST_SEGMENT bytes and forwards each
+ * segment to its children as soon as it has arrived, so that the levels of
+ * the tree overlap. A node acknowledges (TORC_BCAST_DONE) to its parent once
+ * it has forwarded the whole buffer and all its children have acknowledged;
+ * the broadcast is complete when the root has been acknowledged.
+ *
+ * The data of a collective travels with a tag of its own, taken from
+ * TORC_COLL_TAGS tags above the tags of the threads. The segments of a
+ * broadcast share its tag and are matched in order: the completion callbacks
+ * may run in any order, so the next segment to receive, forward or send is
+ * taken in sequence under the lock of the broadcast.
+ *
+ * Reductions and gathers go the other way up the same tree. The header
+ * (TORC_REDUCE, TORC_GATHER) goes down first. Every node then receives the
+ * results of the subtrees of its children, adds its own contribution and
+ * sends one message to its parent. A gather places the subtrees side by side.
+ * A reduction combines the children in a fixed order, so the result does not
+ * depend on the order in which their messages arrive.
+ */
+/**@{*/
+
+//! Segment of a broadcast in bytes
+#ifndef TORC_BCAST_SEGMENT
+#define TORC_BCAST_SEGMENT (256 * 1024)
+#endif
+
+//! Segments of a broadcast in flight on each edge of the tree
+#define TORC_BCAST_DEPTH 4
+
+//! Tags of the collectives, after the tags of the threads and the server thread
+#define TORC_COLL_TAG (MAX_NVPS + 1)
+#define TORC_COLL_TAGS 4096
+
+//! Children of a node in a binomial tree
+#define TORC_TREE_MAX 32
+
+//! Transfers started by one completion callback of a broadcast
+#define TORC_BCAST_OPS (TORC_BCAST_DEPTH * TORC_TREE_MAX + 1)
+
+struct torc_bcast;
+
+/**
+ * @brief Segment of a broadcast
+ *
+ */
+typedef struct
+{
+    struct torc_bcast *b;
+    int k;
+    //! the segment has been received
+    int arrived;
+    //! sends of the segment to the children still in progress
+    int sends;
+} torc_bcast_seg_t;
+
+/**
+ * @brief Transfers started under the lock of a broadcast, handed to the
+ * progress engine after the lock is released
+ *
+ */
+typedef struct
+{
+    int n;
+    MPI_Request reqs[TORC_BCAST_OPS];
+    torc_progress_cb cbs[TORC_BCAST_OPS];
+    void *args[TORC_BCAST_OPS];
+} torc_bcast_ops_t;
+
+/**
+ * @brief Broadcast in progress on a node
+ *
+ */
+struct torc_bcast
+{
+    char *buffer;
+    long count;
+    MPI_Datatype dtype;
+    int typesize;
+    //! elements of a segment
+    long segment;
+    int nsegs;
+    int tag;
+    //! the parent and its broadcast, -1 at the root
+    int parent;
+    INT64 parent_op;
+    int children[TORC_TREE_MAX];
+    int nchildren;
+    torc_bcast_seg_t *segs;
+    //! protects the sequence of the transfers
+    _lock_t lock;
+    //! next segment to receive, to forward (relay) and to send (root)
+    int next_recv;
+    int next_fwd;
+    int next_send;
+    //! transfers and acknowledgements still to complete
+    int pending;
+    //! the broadcast is complete (root)
+    volatile int done;
+};
+
+//! Collectives started by this node
+static int coll_seq = 0;
+
+/**
+ * @brief Tag of a new collective rooted at this node
+ *
+ */
+static int torc_coll_tag()
+{
+    int const seq = __sync_fetch_and_add(&coll_seq, 1);
+
+    return TORC_COLL_TAG + (int)(((long)seq * torc_num_nodes() + torc_node_id()) % TORC_COLL_TAGS);
+}
+
+/**
+ * @brief Parent and children of this node in the binomial tree rooted at root
+ * The children are ordered from the largest subtree to the smallest
+ *
+ * @param root     root node
+ * @param parent   set to the parent node, -1 at the root
+ * @param children children nodes
+ * @return int number of children
+ */
+static int torc_tree(int root, int *parent, int *children)
+{
+    int const nnodes = torc_num_nodes();
+    int const r = (torc_node_id() - root + nnodes) % nnodes;
+
+    *parent = -1;
+
+    int mask = 1;
+    while (mask < nnodes)
+    {
+        if (r & mask)
+        {
+            *parent = (r - mask + root) % nnodes;
+            break;
+        }
+        mask <<= 1;
+    }
+
+    int n = 0;
+    for (mask >>= 1; mask > 0; mask >>= 1)
+    {
+        if (r + mask < nnodes)
+        {
+            children[n++] = (r + mask + root) % nnodes;
+        }
+    }
+
+    return n;
+}
+
+/**
+ * @brief Length in elements of segment k
+ *
+ */
+static inline int bcast_seg_count(struct torc_bcast *b, int k)
+{
+    long const first = k * b->segment;
+
+    return (int)(((b->count - first) < b->segment) ? (b->count - first) : b->segment);
+}
+
+static void bcast_received(void *arg);
+static void bcast_sent(void *arg);
+
+/**
+ * @brief Acknowledge to the parent, or mark the broadcast complete at the root
+ *
+ */
+static void bcast_release(struct torc_bcast *b, int n)
+{
+    if (__sync_sub_and_fetch(&b->pending, n) > 0)
+    {
+        return;
+    }
+
+    if (b->parent < 0)
+    {
+        b->done = 1;
+        return;
+    }
+
+    torc_t *ack = _torc_get_reused_desc(1);
+    ack->narg = 1;
+    ack->homenode = b->parent;
+    ack->arg[0].localarg = b->parent_op;
+
+    post_descriptor(b->parent, ack, TORC_BCAST_DONE);
+
+    free(b->segs);
+    free(b);
+}
+
+/**
+ * @brief Send segment k to the children
+ * The caller holds the lock of the broadcast
+ *
+ */
+static void bcast_isend(struct torc_bcast *b, int k, torc_bcast_ops_t *ops)
+{
+    char *data = b->buffer + k * b->segment * b->typesize;
+    int const count = bcast_seg_count(b, k);
+
+    for (int c = 0; c < b->nchildren; c++)
+    {
+        enter_comm_cs();
+        MPI_Isend(data, count, b->dtype, b->children[c], b->tag, comm_out, &ops->reqs[ops->n]);
+        leave_comm_cs();
+
+        ops->cbs[ops->n] = bcast_sent;
+        ops->args[ops->n] = &b->segs[k];
+        ops->n++;
+    }
+}
+
+/**
+ * @brief Receive segment k from the parent
+ * The caller holds the lock of the broadcast
+ *
+ */
+static void bcast_irecv(struct torc_bcast *b, int k, torc_bcast_ops_t *ops)
+{
+    char *data = b->buffer + k * b->segment * b->typesize;
+    int const count = bcast_seg_count(b, k);
+
+    enter_comm_cs();
+    MPI_Irecv(data, count, b->dtype, b->parent, b->tag, comm_out, &ops->reqs[ops->n]);
+    leave_comm_cs();
+
+    ops->cbs[ops->n] = bcast_received;
+    ops->args[ops->n] = &b->segs[k];
+    ops->n++;
+}
+
+/**
+ * @brief Hand the started transfers to the progress engine
+ *
+ */
+static void bcast_post(torc_bcast_ops_t *ops)
+{
+    for (int i = 0; i < ops->n; i++)
+    {
+        torc_progress_post(ops->reqs[i], ops->cbs[i], ops->args[i]);
+    }
+}
+
+/**
+ * @brief Completion callback of a received segment
+ * The segments that have arrived in order are forwarded and the next one is received
+ *
+ */
+static void bcast_received(void *arg)
+{
+    torc_bcast_seg_t *seg = (torc_bcast_seg_t *)arg;
+    struct torc_bcast *b = seg->b;
+
+    torc_bcast_ops_t ops;
+    ops.n = 0;
+
+    _lock_acquire(&b->lock);
+    seg->arrived = 1;
+    while ((b->next_fwd < b->nsegs) && b->segs[b->next_fwd].arrived)
+    {
+        bcast_isend(b, b->next_fwd++, &ops);
+    }
+    if (b->next_recv < b->nsegs)
+    {
+        bcast_irecv(b, b->next_recv++, &ops);
+    }
+    _lock_release(&b->lock);
+
+    bcast_post(&ops);
+
+    bcast_release(b, 1);
+}
+
+/**
+ * @brief Completion callback of a sent segment
+ * The root sends the next segment once one has reached all its children
+ *
+ */
+static void bcast_sent(void *arg)
+{
+    torc_bcast_seg_t *seg = (torc_bcast_seg_t *)arg;
+    struct torc_bcast *b = seg->b;
+
+    if ((__sync_sub_and_fetch(&seg->sends, 1) == 0) && (b->parent < 0))
+    {
+        torc_bcast_ops_t ops;
+        ops.n = 0;
+
+        _lock_acquire(&b->lock);
+        if (b->next_send < b->nsegs)
+        {
+            bcast_isend(b, b->next_send++, &ops);
+        }
+        _lock_release(&b->lock);
+
+        bcast_post(&ops);
+    }
+
+    bcast_release(b, 1);
+}
+
+/**
+ * @brief Start a broadcast on this node: forward the header, then the segments
+ *
+ * @param root   root node
+ * @param buffer data
+ * @param count  number of elements
+ * @param dtype  MPI datatype
+ * @param tag    tag of the data
+ * @param parent_op broadcast of the parent, acknowledged at the end
+ * @return struct torc_bcast*
+ */
+static struct torc_bcast *bcast_start(int root, void *buffer, long count, MPI_Datatype dtype, int tag, INT64 parent_op)
+{
+    struct torc_bcast *b = (struct torc_bcast *)calloc(1, sizeof(struct torc_bcast));
+
+    b->buffer = (char *)buffer;
+    b->count = count;
+    b->dtype = dtype;
+    MPI_Type_size(dtype, &b->typesize);
+    b->segment = ((b->typesize > 0) && (b->typesize < TORC_BCAST_SEGMENT)) ? TORC_BCAST_SEGMENT / b->typesize : 1;
+    b->nsegs = (int)((count + b->segment - 1) / b->segment);
+    b->tag = tag;
+    b->parent_op = parent_op;
+    b->nchildren = torc_tree(root, &b->parent, b->children);
+    _lock_init(&b->lock);
+
+    b->segs = (torc_bcast_seg_t *)calloc((b->nsegs > 0) ? b->nsegs : 1, sizeof(torc_bcast_seg_t));
+    for (int k = 0; k < b->nsegs; k++)
+    {
+        b->segs[k].b = b;
+        b->segs[k].k = k;
+        b->segs[k].sends = b->nchildren;
+    }
+
+    //! receives, sends and acknowledgements, held until everything is posted
+    b->pending = ((b->parent >= 0) ? b->nsegs : 0) + b->nsegs * b->nchildren + b->nchildren + 1;
+
+    for (int c = 0; c < b->nchildren; c++)
+    {
+        torc_t *header = _torc_get_reused_desc(6);
+        header->narg = 6;
+        header->homenode = b->children[c];
+        header->arg[0].localarg = root;
+        header->arg[1].localarg = (INT64)buffer;
+        header->arg[2].localarg = count;
+        header->arg[3].localarg = _torc_mpi2b_type(dtype);
+        header->arg[4].localarg = tag;
+        header->arg[5].localarg = (INT64)b;
+
+        post_descriptor(b->children[c], header, TORC_BCAST);
+    }
+
+    torc_bcast_ops_t ops;
+    ops.n = 0;
+
+    _lock_acquire(&b->lock);
+    for (int k = 0; (k < TORC_BCAST_DEPTH) && (k < b->nsegs); k++)
+    {
+        if (b->parent >= 0)
+        {
+            bcast_irecv(b, b->next_recv++, &ops);
+        }
+        else
+        {
+            bcast_isend(b, b->next_send++, &ops);
+        }
+    }
+    _lock_release(&b->lock);
+
+    bcast_post(&ops);
+
+    bcast_release(b, 1);
+
+    return b;
+}
+
+/**
+ * @brief Take part in a broadcast (server thread)
+ *
+ * @param desc TORC_BCAST header from the parent
+ */
+void _torc_bcast_relay(torc_t *desc)
+{
+    int const root = (int)desc->arg[0].localarg;
+    void *buffer = (void *)desc->arg[1].localarg;
+    long const count = (long)desc->arg[2].localarg;
+    MPI_Datatype const dtype = _torc_b2mpi_type((int)desc->arg[3].localarg);
+    int const tag = (int)desc->arg[4].localarg;
+
+#if DEBUG
+    printf("TORC_BCAST: %p %ld from %d\n", buffer, count, desc->sourcenode);
+    fflush(0);
+#endif
+
+    bcast_start(root, buffer, count, dtype, tag, desc->arg[5].localarg);
+}
+
+/**
+ * @brief Acknowledgement of a child (server thread)
+ *
+ * @param desc TORC_BCAST_DONE descriptor
+ */
+void _torc_bcast_done(torc_t *desc)
+{
+    bcast_release((struct torc_bcast *)desc->arg[0].localarg, 1);
+}
+
+/**
+ * @brief Start broadcasting a buffer from this node to the others
+ * The buffer has the same address on all the nodes (e.g. a global variable)
+ * and must not be modified before the broadcast is complete
+ *
+ * @param buffer data
+ * @param count  number of elements
+ * @param dtype  MPI datatype
+ * @return torc_bcast_t handle, for torc_ibroadcast_wait or torc_ibroadcast_test
+ */
+torc_bcast_t torc_ibroadcast(void *buffer, long count, MPI_Datatype dtype)
+{
+#if DEBUG
+    printf("Broadcasting data ...\n");
+    fflush(0);
+#endif
+
+    return bcast_start(torc_node_id(), buffer, count, dtype, torc_coll_tag(), 0);
+}
+
+/**
+ * @brief Drive the progress engine until a collective started by this node is complete
+ *
+ */
+static void torc_coll_wait(volatile int *done)
+{
+    while (!*done)
+    {
+        if (!torc_progress())
+        {
+            sched_yield();
+        }
+    }
+}
+
+/**
+ * @brief Wait until a broadcast has reached all the nodes
+ *
+ * @param handle handle of torc_ibroadcast, set to NULL
+ */
+void torc_ibroadcast_wait(torc_bcast_t *handle)
+{
+    struct torc_bcast *b = *handle;
+
+    if (b == NULL)
+    {
+        return;
+    }
+
+    torc_coll_wait(&b->done);
+
+    free(b->segs);
+    free(b);
+    *handle = NULL;
+}
+
+/**
+ * @brief Check whether a broadcast has reached all the nodes, without blocking
+ *
+ * @param handle handle of torc_ibroadcast, set to NULL once the broadcast is complete
+ * @return int 1 if the broadcast is complete
+ */
+int torc_ibroadcast_test(torc_bcast_t *handle)
+{
+    struct torc_bcast *b = *handle;
+
+    if (b == NULL)
+    {
+        return 1;
+    }
+
+    if (!b->done)
+    {
+        torc_progress();
+
+        if (!b->done)
+        {
+            return 0;
+        }
+    }
+
+    free(b->segs);
+    free(b);
+    *handle = NULL;
+
+    return 1;
+}
+
+/**
+ * @brief Broadcast a buffer from this node to the others
+ * On return, all the nodes have received the data and the buffer is reusable
+ *
+ * @param buffer data
+ * @param count  number of elements
+ * @param dtype  MPI datatype
+ */
+void torc_broadcast(void *buffer, long count, MPI_Datatype dtype)
+{
+    torc_bcast_t handle = torc_ibroadcast(buffer, count, dtype);
+
+    torc_ibroadcast_wait(&handle);
+}
+
+/**
+ * @brief Reduction or gather in progress on a node
+ *
+ */
+struct torc_gather
+{
+    //! TORC_REDUCE or TORC_GATHER
+    int type;
+    //! elements of the contribution of a node
+    long count;
+    MPI_Datatype dtype;
+    int typesize;
+    int tag;
+    torc_combiner_t op;
+    int parent;
+    int children[TORC_TREE_MAX];
+    int nchildren;
+    //! nodes whose contributions are in acc
+    long nnodes;
+    //! result of the subtree: one contribution (reduce), or one per node of the subtree in tree order (gather)
+    char *acc;
+    //! contributions of the children (reduce)
+    char *in;
+    //! messages of the children still to arrive
+    int pending;
+    //! the result is complete (root)
+    volatile int done;
+};
+
+/**
+ * @brief Position of node in the tree rooted at root
+ *
+ */
+static inline int torc_tree_rank(int root, int node)
+{
+    return (node - root + torc_num_nodes()) % torc_num_nodes();
+}
+
+/**
+ * @brief Number of nodes in the subtree of position r of the binomial tree
+ *
+ */
+static int torc_subtree(int r)
+{
+    int const nnodes = torc_num_nodes();
+
+    if (r == 0)
+    {
+        return nnodes;
+    }
+
+    int const size = r & -r;
+
+    return (size < nnodes - r) ? size : nnodes - r;
+}
+
+/**
+ * @brief Built-in combiners
+ *
+ */
+enum
+{
+    TORC_OP_SUM = 0,
+    TORC_OP_PROD,
+    TORC_OP_MIN,
+    TORC_OP_MAX
+};
+
+#define TORC_OP_LOOP(T, expr)                 \
+    {                                         \
+        T *a = (T *)inout;                    \
+        T const *b = (T const *)in;           \
+        for (long i = 0; i < count; i++)      \
+        {                                     \
+            a[i] = (expr);                    \
+        }                                     \
+    }
+
+#define TORC_OP_TYPE(T)                                          \
+    {                                                            \
+        switch (what)                                            \
+        {                                                        \
+        case TORC_OP_SUM:                                        \
+            TORC_OP_LOOP(T, a[i] + b[i]);                        \
+            break;                                               \
+        case TORC_OP_PROD:                                       \
+            TORC_OP_LOOP(T, a[i] * b[i]);                        \
+            break;                                               \
+        case TORC_OP_MIN:                                        \
+            TORC_OP_LOOP(T, (b[i] < a[i]) ? b[i] : a[i]);        \
+            break;                                               \
+        case TORC_OP_MAX:                                        \
+            TORC_OP_LOOP(T, (b[i] > a[i]) ? b[i] : a[i]);        \
+            break;                                               \
+        }                                                        \
+    }                                                            \
+    break
+
+/**
+ * @brief Apply a built-in combiner to count elements of one of the T_MPI_* types
+ *
+ */
+static void torc_op_apply(int what, void *inout, void const *in, long count, MPI_Datatype dtype)
+{
+    switch (_torc_mpi2b_type(dtype))
+    {
+    case T_MPI_CHAR:
+    case T_MPI_CHARACTER:
+        TORC_OP_TYPE(char);
+    case T_MPI_INT:
+    case T_MPI_INTEGER:
+        TORC_OP_TYPE(int);
+    case T_MPI_UNSIGNED:
+        TORC_OP_TYPE(unsigned int);
+    case T_MPI_LONG:
+        TORC_OP_TYPE(long);
+    case T_MPI_UNSIGNED_LONG:
+        TORC_OP_TYPE(unsigned long);
+    case T_MPI_LONG_LONG:
+        TORC_OP_TYPE(long long);
+    case T_MPI_UNSIGNED_LONG_LONG:
+        TORC_OP_TYPE(unsigned long long);
+    case T_MPI_FLOAT:
+    case T_MPI_REAL:
+        TORC_OP_TYPE(float);
+    case T_MPI_DOUBLE:
+    case T_MPI_DOUBLE_PRECISION:
+        TORC_OP_TYPE(double);
+    case T_MPI_LONG_DOUBLE:
+        TORC_OP_TYPE(long double);
+    default:
+        Error("unsupported TORC data type in a reduction");
+        break;
+    }
+}
+
+#undef TORC_OP_TYPE
+#undef TORC_OP_LOOP
+
+/**
+ * @brief Built-in combiners: inout[i] = inout[i] (op) in[i]
+ *
+ */
+void torc_op_sum(void *inout, void const *in, long count, MPI_Datatype dtype)
+{
+    torc_op_apply(TORC_OP_SUM, inout, in, count, dtype);
+}
+
+void torc_op_prod(void *inout, void const *in, long count, MPI_Datatype dtype)
+{
+    torc_op_apply(TORC_OP_PROD, inout, in, count, dtype);
+}
+
+void torc_op_min(void *inout, void const *in, long count, MPI_Datatype dtype)
+{
+    torc_op_apply(TORC_OP_MIN, inout, in, count, dtype);
+}
+
+void torc_op_max(void *inout, void const *in, long count, MPI_Datatype dtype)
+{
+    torc_op_apply(TORC_OP_MAX, inout, in, count, dtype);
+}
+
+//! Built-in combiners, identified by their position on the other nodes
+static torc_combiner_t const torc_builtin_ops[] = {torc_op_sum, torc_op_prod, torc_op_min, torc_op_max};
+
+#define TORC_BUILTIN_OPS ((int)(sizeof(torc_builtin_ops) / sizeof(torc_builtin_ops[0])))
+
+/**
+ * @brief Identify a combiner for the other nodes
+ * Built-in combiners are encoded as -2 - position, registered ones by their
+ * position in the table of tasks, the rest (-1) by their address
+ *
+ */
+static INT64 torc_op_encode(torc_combiner_t op)
+{
+    for (int k = 0; k < TORC_BUILTIN_OPS; k++)
+    {
+        if (op == torc_builtin_ops[k])
+        {
+            return -2 - k;
+        }
+    }
+
+    int const id = getfuncnum((func_t)op);
+    if (id == -1)
+    {
+        printf("Combiner %p not registered\n", op);
+    }
+
+    return id;
+}
+
+/**
+ * @brief Combiner of a header, see torc_op_encode
+ *
+ */
+static torc_combiner_t torc_op_decode(INT64 id, INT64 addr)
+{
+    if (id <= -2)
+    {
+        return torc_builtin_ops[-2 - id];
+    }
+    if (id >= 0)
+    {
+        return (torc_combiner_t)getfuncptr((int)id);
+    }
+    return (torc_combiner_t)addr;
+}
+
+/**
+ * @brief Completion callback of the message to the parent
+ *
+ */
+static void gather_sent(void *arg)
+{
+    struct torc_gather *g = (struct torc_gather *)arg;
+
+    free(g->acc);
+    free(g->in);
+    free(g);
+}
+
+/**
+ * @brief Complete the result of the subtree once all the children have sent theirs
+ * The root marks the collective complete, the others send the result to their parent
+ *
+ */
+static void gather_release(struct torc_gather *g)
+{
+    if (__sync_sub_and_fetch(&g->pending, 1) > 0)
+    {
+        return;
+    }
+
+    long const bytes = g->count * g->typesize;
+
+    if (g->type == TORC_REDUCE)
+    {
+        //! the smallest subtree first, so that the nodes are combined in tree order
+        for (int c = g->nchildren - 1; c >= 0; c--)
+        {
+            g->op(g->acc, g->in + c * bytes, g->count, g->dtype);
+        }
+    }
+
+    if (g->parent < 0)
+    {
+        g->done = 1;
+        return;
+    }
+
+    long const count = (g->type == TORC_REDUCE) ? g->count : g->count * g->nnodes;
+    MPI_Request request;
+
+    enter_comm_cs();
+    MPI_Isend(g->acc, (int)count, g->dtype, g->parent, g->tag, comm_out, &request);
+    leave_comm_cs();
+
+    torc_progress_post(request, gather_sent, g);
+}
+
+/**
+ * @brief Completion callback of the message of a child
+ *
+ */
+static void gather_received(void *arg)
+{
+    gather_release((struct torc_gather *)arg);
+}
+
+/**
+ * @brief Start a reduction or a gather on this node: receive from the
+ * children, forward the header and add the local contribution
+ *
+ * @param type    TORC_REDUCE or TORC_GATHER
+ * @param root    root node
+ * @param sendbuf contribution of this node
+ * @param count   number of elements of a contribution
+ * @param dtype   MPI datatype
+ * @param op      combiner (reduce)
+ * @param tag     tag of the data
+ * @return struct torc_gather*
+ */
+static struct torc_gather *gather_start(int type, int root, void *sendbuf, long count, MPI_Datatype dtype,
+                                        torc_combiner_t op, int tag)
+{
+    struct torc_gather *g = (struct torc_gather *)calloc(1, sizeof(struct torc_gather));
+
+    g->type = type;
+    g->count = count;
+    g->dtype = dtype;
+    MPI_Type_size(dtype, &g->typesize);
+    g->tag = tag;
+    g->op = op;
+    g->nchildren = torc_tree(root, &g->parent, g->children);
+
+    int const r = torc_tree_rank(root, torc_node_id());
+    long const bytes = count * g->typesize;
+
+    g->nnodes = (type == TORC_REDUCE) ? 1 : torc_subtree(r);
+    g->acc = (char *)malloc((g->nnodes * bytes > 0) ? g->nnodes * bytes : 1);
+    memcpy(g->acc, sendbuf, bytes);
+
+    if ((type == TORC_REDUCE) && (g->nchildren > 0))
+    {
+        g->in = (char *)malloc((g->nchildren * bytes > 0) ? g->nchildren * bytes : 1);
+    }
+
+    //! the children, and a guard held until the headers are sent
+    g->pending = g->nchildren + 1;
+
+    for (int c = 0; c < g->nchildren; c++)
+    {
+        int const rc = torc_tree_rank(root, g->children[c]);
+        char *data;
+        long n;
+
+        if (type == TORC_REDUCE)
+        {
+            data = g->in + c * bytes;
+            n = count;
+        }
+        else
+        {
+            //! the subtree of a child follows that of this node
+            data = g->acc + (rc - r) * bytes;
+            n = torc_subtree(rc) * count;
+        }
+
+        MPI_Request request;
+
+        enter_comm_cs();
+        MPI_Irecv(data, (int)n, dtype, g->children[c], tag, comm_out, &request);
+        leave_comm_cs();
+
+        torc_progress_post(request, gather_received, g);
+    }
+
+    for (int c = 0; c < g->nchildren; c++)
+    {
+        torc_t *header = _torc_get_reused_desc(7);
+        header->narg = 7;
+        header->homenode = g->children[c];
+        header->arg[0].localarg = root;
+        header->arg[1].localarg = (INT64)sendbuf;
+        header->arg[2].localarg = count;
+        header->arg[3].localarg = _torc_mpi2b_type(dtype);
+        header->arg[4].localarg = tag;
+        header->arg[5].localarg = (type == TORC_REDUCE) ? torc_op_encode(op) : -1;
+        header->arg[6].localarg = (INT64)op;
+
+        post_descriptor(g->children[c], header, type);
+    }
+
+    gather_release(g);
+
+    return g;
+}
+
+/**
+ * @brief Take part in a reduction or a gather (server thread)
+ *
+ * @param desc TORC_REDUCE or TORC_GATHER header from the parent
+ * @param type type of the header
+ */
+void _torc_gather_relay(torc_t *desc, int type)
+{
+    int const root = (int)desc->arg[0].localarg;
+    void *sendbuf = (void *)desc->arg[1].localarg;
+    long const count = (long)desc->arg[2].localarg;
+    MPI_Datatype const dtype = _torc_b2mpi_type((int)desc->arg[3].localarg);
+    int const tag = (int)desc->arg[4].localarg;
+    torc_combiner_t op = (type == TORC_REDUCE) ? torc_op_decode(desc->arg[5].localarg, desc->arg[6].localarg) : NULL;
+
+#if DEBUG
+    printf("TORC_%s: %p %ld from %d\n", (type == TORC_REDUCE) ? "REDUCE" : "GATHER", sendbuf, count, desc->sourcenode);
+    fflush(0);
+#endif
+
+    gather_start(type, root, sendbuf, count, dtype, op, tag);
+}
+
+/**
+ * @brief Combine the contributions of all the nodes on this node
+ * The contribution of every node is at address sendbuf of that node (e.g. a
+ * global variable) and must not change before the reduction is complete.
+ * The combiner must be associative and commutative.
+ *
+ * @param sendbuf contribution of each node
+ * @param recvbuf result, on this node
+ * @param count   number of elements
+ * @param dtype   MPI datatype, one of the T_MPI_* types
+ * @param op      TORC_SUM, TORC_PROD, TORC_MIN, TORC_MAX or a combiner registered with torc_register_task
+ */
+void torc_reduce(void *sendbuf, void *recvbuf, long count, MPI_Datatype dtype, torc_combiner_t op)
+{
+    struct torc_gather *g = gather_start(TORC_REDUCE, torc_node_id(), sendbuf, count, dtype, op, torc_coll_tag());
+
+    torc_coll_wait(&g->done);
+
+    memcpy(recvbuf, g->acc, count * g->typesize);
+
+    free(g->acc);
+    free(g->in);
+    free(g);
+}
+
+/**
+ * @brief Combine the contributions of all the nodes on every node
+ * The result is broadcast from this node, so recvbuf has the same address on
+ * all the nodes as well
+ *
+ * @param sendbuf contribution of each node
+ * @param recvbuf result, on every node
+ * @param count   number of elements
+ * @param dtype   MPI datatype, one of the T_MPI_* types
+ * @param op      combiner, see torc_reduce
+ */
+void torc_allreduce(void *sendbuf, void *recvbuf, long count, MPI_Datatype dtype, torc_combiner_t op)
+{
+    torc_reduce(sendbuf, recvbuf, count, dtype, op);
+
+    torc_broadcast(recvbuf, count, dtype);
+}
+
+/**
+ * @brief Collect the contributions of all the nodes on this node
+ * The contribution of every node is at address sendbuf of that node (e.g. a
+ * global variable) and must not change before the gather is complete
+ *
+ * @param sendbuf contribution of each node
+ * @param recvbuf contributions of nodes 0, 1, ..., one after the other, on this node
+ * @param count   number of elements of a contribution
+ * @param dtype   MPI datatype, one of the T_MPI_* types
+ */
+void torc_gather(void *sendbuf, void *recvbuf, long count, MPI_Datatype dtype)
+{
+    int const root = torc_node_id();
+    int const nnodes = torc_num_nodes();
+
+    struct torc_gather *g = gather_start(TORC_GATHER, root, sendbuf, count, dtype, NULL, torc_coll_tag());
+
+    torc_coll_wait(&g->done);
+
+    //! from tree order to node order
+    long const bytes = count * g->typesize;
+    for (int r = 0; r < nnodes; r++)
+    {
+        memcpy((char *)recvbuf + ((r + root) % nnodes) * bytes, g->acc + r * bytes, bytes);
+    }
+
+    free(g->acc);
+    free(g);
+}
+
+/**@}*/
@@ -12,11 +12,38 @@
 //! Node Inofrmation
 struct node_info *node_info;
 
+/**
+ * @brief Slot of the index of the registered tasks
+ *
+ */
+typedef struct
+{
+    func_t f;
+    int id;
+} torc_func_slot_t;
+
+/**
+ * @brief Registered tasks: the function of each id, and an open-addressing
+ * (linear probing) index from function to id with at most half of its slots used
+ *
+ */
+typedef struct
+{
+    func_t *table;
+    int capacity;
+    torc_func_slot_t *slots;
+    unsigned long mask;
+} torc_func_registry_t;
+
 //! Number of registered tasks(functions)
 static int number_of_functions = 0;
 
-//! Table of tasks
-static func_t internode_function_table[MAX_TORC_TASKS];
+//! Table of tasks, replaced when it grows; the old ones are kept for concurrent lookups
+//! The table, the number of tasks and the functions of the index are published with release stores
+static torc_func_registry_t *internode_function_table = NULL;
+
+//! Serializes the registrations
+static pthread_mutex_t function_table_m = PTHREAD_MUTEX_INITIALIZER;
 
 //! Communication mutex object
 pthread_mutex_t comm_m = PTHREAD_MUTEX_INITIALIZER;
@@ -24,8 +51,27 @@ pthread_mutex_t comm_m = PTHREAD_MUTEX_INITIALIZER;
 //! External flag to register the function even after torc_init
 extern int torc_initialized;
 
-//! Size of the data structure
-static unsigned long torc_size = sizeof(torc_t);
+/**
+ * @brief Send buffer of the remote enqueues to one node
+ *
+ */
+typedef struct torc_aggr
+{
+    _lock_t lock;
+    //! batch header followed by the entries, NULL when empty
+    char *buf;
+    size_t len;
+    int count;
+    //! time of the first entry
+    double t0;
+} torc_aggr_t;
+
+//! Per-destination send buffers
+static torc_aggr_t *aggr;
+
+//! Number of non-empty send buffers
+static volatile int aggr_nonempty = 0;
+
 
 /**
  * @brief locks the mutex before the scope, in case of MPI implementation is not thread safe
@@ -56,6 +102,109 @@ void leave_comm_cs()
  */
 /**@{*/
 
+/**
+ * @brief Home slot of a function in the index
+ *
+ */
+static inline unsigned long torc_func_hash(func_t f, unsigned long mask)
+{
+    return (((unsigned long)f >> 3) * 0x9E3779B97F4A7C15UL >> 32) & mask;
+}
+
+/**
+ * @brief Add a function to the index, unless it is already there
+ * The first id of a function registered twice is kept
+ *
+ */
+static void torc_func_index(torc_func_registry_t *reg, func_t f, int id)
+{
+    unsigned long i = torc_func_hash(f, reg->mask);
+
+    while (reg->slots[i].f != NULL)
+    {
+        if (reg->slots[i].f == f)
+        {
+            return;
+        }
+        i = (i + 1) & reg->mask;
+    }
+
+    //! a lookup that finds the function finds its id
+    reg->slots[i].id = id;
+    __atomic_store_n(&reg->slots[i].f, f, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Table of tasks with room for at least capacity functions
+ * The caller holds function_table_m
+ *
+ */
+static torc_func_registry_t *torc_func_grow(torc_func_registry_t *old, int capacity)
+{
+    torc_func_registry_t *reg = (torc_func_registry_t *)calloc(1, sizeof(torc_func_registry_t));
+
+    unsigned long nslots = 1;
+    while (nslots < 2 * (unsigned long)capacity)
+    {
+        nslots <<= 1;
+    }
+
+    reg->capacity = capacity;
+    reg->table = (func_t *)calloc(capacity, sizeof(func_t));
+    reg->slots = (torc_func_slot_t *)calloc(nslots, sizeof(torc_func_slot_t));
+    reg->mask = nslots - 1;
+
+    if ((reg->table == NULL) || (reg->slots == NULL))
+    {
+        printf("Cannot grow the table of tasks to %d functions\n", capacity);
+        Error("out of memory while registering a task");
+    }
+
+    for (int id = 0; id < number_of_functions; id++)
+    {
+        reg->table[id] = old->table[id];
+        torc_func_index(reg, old->table[id], id);
+    }
+
+    return reg;
+}
+
+/**
+ * @brief Append a task to the table of tasks of this node
+ * The table starts with MAX_TORC_TASKS entries and doubles when it is full
+ *
+ * @param f Input task(function)
+ */
+static void torc_register_function(func_t f)
+{
+    pthread_mutex_lock(&function_table_m);
+
+    torc_func_registry_t *reg = internode_function_table;
+    int const id = number_of_functions;
+
+    if (reg == NULL)
+    {
+        reg = torc_func_grow(NULL, MAX_TORC_TASKS);
+    }
+    else if (id == reg->capacity)
+    {
+        if (reg->capacity >= (1 << 30))
+        {
+            Error("too many registered tasks");
+        }
+        reg = torc_func_grow(reg, 2 * reg->capacity);
+    }
+
+    reg->table[id] = f;
+    torc_func_index(reg, f, id);
+
+    //! the new table and the new id are visible after their contents
+    __atomic_store_n(&internode_function_table, reg, __ATOMIC_RELEASE);
+    __atomic_store_n(&number_of_functions, id + 1, __ATOMIC_RELEASE);
+
+    pthread_mutex_unlock(&function_table_m);
+}
+
 /**
  * @brief Register a task
  * We have to register different tasks
@@ -65,8 +214,7 @@ void leave_comm_cs()
 void torc_register_task_internal(long long *F)
 {
     void *f = (void *)*F;
-    internode_function_table[number_of_functions] = (func_t)f;
-    number_of_functions++;
+    torc_register_function((func_t)f);
 }
 
 /**
@@ -90,8 +238,7 @@ void torc_register_task(void *f)
         return;
     }
 
-    internode_function_table[number_of_functions] = (func_t)f;
-    number_of_functions++;
+    torc_register_function((func_t)f);
 }
 
 /**@}*/
@@ -104,14 +251,26 @@ void torc_register_task(void *f)
  */
 int getfuncnum(func_t f)
 {
-    for (int i = 0; i < number_of_functions; i++)
+    torc_func_registry_t *reg = __atomic_load_n(&internode_function_table, __ATOMIC_ACQUIRE);
+
+    if ((reg == NULL) || (f == NULL))
+    {
+        return -1;
+    }
+
+    for (unsigned long i = torc_func_hash(f, reg->mask);; i = (i + 1) & reg->mask)
     {
-        if (f == internode_function_table[i])
+        func_t const g = __atomic_load_n(&reg->slots[i].f, __ATOMIC_ACQUIRE);
+
+        if (g == NULL)
         {
-            return i;
+            return -1;
+        }
+        if (g == f)
+        {
+            return reg->slots[i].id;
         }
     }
-    return -1;
 }
 
 /**
@@ -120,11 +279,20 @@ int getfuncnum(func_t f)
  * @param pos Index of a function in the table
  * 
  * @return func_t Functin pointer 
- * In case of a failure, it returns NULL
+ * An id that this node has not registered stops the application
  */
 func_t getfuncptr(int pos)
 {
-    return (pos < MAX_TORC_TASKS) ? internode_function_table[pos] : NULL;
+    int const n = __atomic_load_n(&number_of_functions, __ATOMIC_ACQUIRE);
+
+    if ((pos < 0) || (pos >= n))
+    {
+        //! the nodes have not registered the same tasks
+        printf("Internode function %d not registered on node %d (%d registered)\n", pos, torc_node_id(), n);
+        Error("unregistered internode function");
+    }
+
+    return __atomic_load_n(&internode_function_table, __ATOMIC_ACQUIRE)->table[pos];
 }
 
 /**
@@ -148,6 +316,12 @@ void _torc_comm_pre_init()
     }
 
     node_info = (struct node_info *)calloc(1, MAX_NODES * sizeof(struct node_info));
+
+    aggr = (torc_aggr_t *)calloc(MAX_NODES, sizeof(torc_aggr_t));
+    for (int i = 0; i < MAX_NODES; i++)
+    {
+        _lock_init(&aggr[i].lock);
+    }
 }
 
 /**
@@ -174,6 +348,15 @@ void _torc_comm_init()
         node_info[i].nworkers = workers[i]; /* SMP */
     }
 
+    //! Nodes of the same host, for the victim selection of inter-node stealing
+    _torc_steal_init();
+
+    //! Rings of the nodes of the same host
+    _torc_shm_init();
+
+    //! Stealing windows of one-sided stealing (TORC_STEAL_RMA)
+    _torc_rma_init();
+
     //! Synchronize execution of workers
     enter_comm_cs();
     MPI_Barrier(comm_out);
@@ -211,288 +394,890 @@ static int _torc_thread_id()
 }
 
 /**
- * @brief Sending arguments
- * 
- * @param node Rank of destination node
- * @param tag  Message tag 
- * @param desc TORC descriptor
+ * \defgroup Wire format
+ * A descriptor travels as a single message: the header and its narg argument
+ * records, followed by the payloads of the shipped arguments in order, each
+ * padded to TORC_PAYLOAD_ALIGN bytes. The sender gathers the pieces in place
+ * with an MPI derived datatype, the receiver unpacks the payloads into one block.
  */
-void send_arguments(int node, int tag, torc_t *desc)
-{
-    MPI_Request request;
+/**@{*/
 
-    for (int i = 0; i < desc->narg; i++)
-    {
-        if (desc->quantity[i] == 0)
-        {
-            continue;
-        }
+//! Alignment of the argument payloads in a message
+#define TORC_PAYLOAD_ALIGN 8
 
-        // By copy || By address
-        if ((desc->callway[i] == CALL_BY_COP) || (desc->callway[i] == CALL_BY_VAD))
-        {
-            /* do not send anything - the value is in the descriptor */
-            if (desc->quantity[i] == 1)
-            {
-                continue;
-            }
+//! What follows the descriptor in a message
+#define TORC_PACK_HEADER 0
+#define TORC_PACK_ARGUMENTS 1
+#define TORC_PACK_RESULTS 2
 
-            enter_comm_cs();
-            if (desc->homenode != desc->sourcenode)
-            {
-                MPI_Isend(&desc->temparg[i], desc->quantity[i], desc->dtype[i], node, tag, comm_out, &request);
-            }
-            else
-            {
-                MPI_Isend(&desc->localarg[i], desc->quantity[i], desc->dtype[i], node, tag, comm_out, &request);
-            }
-            MPI_Wait(&request, MPI_STATUS_IGNORE);
-            leave_comm_cs();
-        }
-        // By reference || By value || By copy
-        else if ((desc->callway[i] == CALL_BY_REF) || (desc->callway[i] == CALL_BY_PTR) || (desc->callway[i] == CALL_BY_COP2))
-        {
-            enter_comm_cs();
-            if (desc->homenode != desc->sourcenode)
-            {
-                MPI_Isend((void *)desc->temparg[i], desc->quantity[i], desc->dtype[i], node, tag, comm_out, &request);
-            }
-            else
-            {
-                MPI_Isend((void *)desc->localarg[i], desc->quantity[i], desc->dtype[i], node, tag, comm_out, &request);
-            }
-            MPI_Wait(&request, MPI_STATUS_IGNORE);
-            leave_comm_cs();
-        }
-        // Nothing for the call By result
-    }
+static inline size_t torc_payload_align(size_t bytes)
+{
+    return (bytes + TORC_PAYLOAD_ALIGN - 1) & ~(size_t)(TORC_PAYLOAD_ALIGN - 1);
 }
 
 /**
- * @brief Sending descriptor
- * Send a descriptor to the target node - always to a server thread
- * 
- * @param node Rank of destination node 
- * @param desc TORC descriptor 
- * @param type Request type, which is one of 
- *      \b DIRECT_SYNCHRONOUS_STEALING_REQUEST
- *      \b TORC_BCAST
- *      \b TORC_ANSWER
- *      \b TORC_NORMAL_ENQUEUE
+ * @brief Size in bytes of the data of an argument
+ *
+ * @param a argument record
+ * @return size_t
  */
-void send_descriptor(int node, torc_t *desc, int type)
+static inline size_t torc_arg_bytes(torc_arg_t *a)
 {
-    MPI_Request request;
-
-    int const tag = _torc_thread_id();
-
-#if DEBUG
-    printf("[%d] - sending to node [%d] desc -> homenode [%d], type = %d\n", torc_node_id(), node, desc->homenode, type);
-    fflush(0);
-#endif
-
-    desc->sourcenode = torc_node_id();
-    //! who sends this
-    desc->sourcevpid = tag;
-    desc->type = type;
+    int typesize;
+    MPI_Type_size(a->dtype, &typesize);
 
-    enter_comm_cs();
-    MPI_Isend(desc, torc_size, MPI_CHAR, node, MAX_NVPS, comm_out, &request);
-    MPI_Wait(&request, MPI_STATUS_IGNORE);
-    leave_comm_cs();
+    return (size_t)a->quantity * typesize;
+}
 
-    switch (desc->type)
+/**
+ * @brief The data of the argument travels with a task (IN and INOUT)
+ *
+ */
+static inline int torc_arg_shipped(torc_arg_t *a)
+{
+    if ((a->quantity == 0) || (a->callway == CALL_BY_RES))
     {
-    case DIRECT_SYNCHRONOUS_STEALING_REQUEST:
-        return;
-        break;
-    case TORC_BCAST:
-        return;
-        break;
-    case TORC_ANSWER:
-        /* in case of call by reference send the data back */
-        for (int i = 0; i < desc->narg; i++)
-        {
-            if (desc->quantity[i] == 0)
-            {
-                continue;
-            }
+        return 0;
+    }
 
-            if ((desc->callway[i] == CALL_BY_COP2) && (desc->quantity[i] > 1))
-            {
-                free((void *)desc->temparg[i]);
-            }
+    //! a single value by copy is already in the descriptor
+    if ((a->callway == CALL_BY_COP) || (a->callway == CALL_BY_VAD))
+    {
+        return (a->quantity > 1);
+    }
 
-            //! send the result back
-            if ((desc->callway[i] == CALL_BY_REF) || (desc->callway[i] == CALL_BY_RES))
-            {
-                enter_comm_cs();
-                MPI_Isend((void *)desc->temparg[i], desc->quantity[i], desc->dtype[i], desc->homenode, tag, comm_out, &request);
-                MPI_Wait(&request, MPI_STATUS_IGNORE);
-                leave_comm_cs();
-
-                if (desc->quantity[i] > 1)
-                {
-                    free((void *)desc->temparg[i]);
-                }
-            }
-        }
-        return;
-        break;
-    //! TORC_NORMAL_ENQUEUE
-    default:
-        if (desc->homenode == node)
-        {
-            return;
-        }
+    return 1;
+}
 
-        send_arguments(node, tag, desc);
-        return;
-        break;
+/**
+ * @brief The argument needs local memory on the executing node
+ *
+ */
+static inline int torc_arg_needs_temp(torc_arg_t *a)
+{
+    if (a->quantity == 0)
+    {
+        return 0;
     }
+
+    return (a->quantity > 1) || ((a->callway != CALL_BY_COP) && (a->callway != CALL_BY_VAD));
 }
 
-void direct_send_descriptor(int dummy, int sourcenode, int sourcevpid, torc_t *desc)
+/**
+ * @brief The data of the argument is returned with the answer (INOUT and OUT)
+ *
+ */
+static inline int torc_arg_result(torc_arg_t *a)
 {
-    MPI_Request request;
+    return (a->quantity > 0) && ((a->callway == CALL_BY_REF) || (a->callway == CALL_BY_RES));
+}
 
-    desc->sourcenode = torc_node_id();
+/**
+ * @brief Collect the payloads that follow the descriptor in a message
+ *
+ * @param desc  TORC descriptor
+ * @param what  TORC_PACK_HEADER, TORC_PACK_ARGUMENTS or TORC_PACK_RESULTS
+ * @param addr  Addresses of the payloads
+ * @param bytes Sizes of the payloads
+ * @return int Number of payloads
+ */
+static int torc_payloads(torc_t *desc, int what, void **addr, size_t *bytes)
+{
+    int n = 0;
 
-    //! the server thread responds to a stealing request from a worker
-    desc->sourcevpid = MAX_NVPS;
+    //! data (address / value) in the owner node or in this node
+    int const home = (desc->homenode == torc_node_id());
 
-    //! response to server's thread direct stealing request
-    if (sourcevpid == MAX_NVPS)
+    for (int i = 0; (what != TORC_PACK_HEADER) && (i < desc->narg); i++)
     {
-        sourcevpid = MAX_NVPS + 1;
-    }
+        torc_arg_t *a = &desc->arg[i];
 
-    int const tag = sourcevpid + 100;
+        if ((what == TORC_PACK_ARGUMENTS) && torc_arg_shipped(a))
+        {
+            INT64 *parg = home ? &a->localarg : &a->temparg;
 
-    enter_comm_cs();
-    //! if sourcevpid == MAX_NVPS
-    MPI_Isend(desc, torc_size, MPI_CHAR, sourcenode, tag, comm_out, &request);
-    MPI_Wait(&request, MPI_STATUS_IGNORE);
-    leave_comm_cs();
+            addr[n] = ((a->callway == CALL_BY_COP) || (a->callway == CALL_BY_VAD)) ? (void *)parg : (void *)*parg;
+        }
+        else if ((what == TORC_PACK_RESULTS) && torc_arg_result(a))
+        {
+            addr[n] = (void *)a->temparg;
+        }
+        else
+        {
+            continue;
+        }
 
-    if (desc->homenode == sourcenode)
-    {
-        return;
+        bytes[n++] = torc_arg_bytes(a);
     }
 
-    send_arguments(sourcenode, tag, desc);
+    return n;
 }
 
-void receive_arguments(torc_t *desc, int tag)
+static size_t packed_size(torc_t *desc, int what);
+static void pack_descriptor(char *out, torc_t *desc, int what);
+
+/**
+ * @brief Send the descriptor and its payloads as one message
+ *
+ * @param node Rank of destination node
+ * @param tag  Message tag
+ * @param desc TORC descriptor
+ * @param what TORC_PACK_HEADER, TORC_PACK_ARGUMENTS or TORC_PACK_RESULTS
+ * @param cb   Completion callback, NULL for a blocking send
+ * @param arg  Argument of the callback
+ */
+static void send_packed(int node, int tag, torc_t *desc, int what, torc_progress_cb cb, void *arg)
 {
-    MPI_Request request;
+    static char const zeros[TORC_PAYLOAD_ALIGN] = {0};
 
-    for (int i = 0; i < desc->narg; i++)
+    void *addr[MAX_TORC_ARGS];
+    size_t bytes[MAX_TORC_ARGS];
+
+    int const npayloads = torc_payloads(desc, what, addr, bytes);
+
+    //! a node of the same host: the message is packed into its ring and the send is complete
+    if (torc_shm_peer(node))
     {
-#if DEBUG
-        printf("reading arg %d (%d - %d)\n", i, desc->quantity[i], desc->callway[i]);
-        fflush(0);
-#endif
-        if (desc->quantity[i] == 0)
+        long pos;
+        char *out = torc_shm_reserve(node, packed_size(desc, what), &pos);
+        if (out != NULL)
         {
-            continue;
+            pack_descriptor(out, desc, what);
+            torc_shm_commit(node, pos);
+
+            if (cb != NULL)
+            {
+                cb(arg);
+            }
+            return;
         }
+    }
 
-        if ((desc->quantity[i] > 1) || ((desc->callway[i] != CALL_BY_COP) && (desc->callway[i] != CALL_BY_VAD)))
-        {
+    int blocklen[1 + 2 * MAX_TORC_ARGS];
+    MPI_Aint displ[1 + 2 * MAX_TORC_ARGS];
 
-            desc->dtype[i] = _torc_b2mpi_type(desc->btype[i]);
+    int nblocks = 0;
 
-            int typesize;
-            MPI_Type_size(desc->dtype[i], &typesize);
+    MPI_Get_address(desc, &displ[nblocks]);
+    blocklen[nblocks++] = TORC_DESC_SIZE(desc->narg);
 
-            char *mem = (char *)calloc(1, desc->quantity[i] * typesize);
+    for (int k = 0; k < npayloads; k++)
+    {
+        MPI_Get_address(addr[k], &displ[nblocks]);
+        blocklen[nblocks++] = (int)bytes[k];
 
-            desc->temparg[i] = (INT64)mem;
-            //! CALL_BY_REF
-            if ((desc->callway[i] != CALL_BY_RES))
-            {
-                enter_comm_cs();
-                MPI_Irecv((void *)desc->temparg[i], desc->quantity[i], desc->dtype[i], desc->sourcenode, tag, comm_out, &request);
-                MPI_Wait(&request, MPI_STATUS_IGNORE);
-                leave_comm_cs();
-            }
-        }
-        else
+        if (bytes[k] % TORC_PAYLOAD_ALIGN)
         {
-            desc->temparg[i] = desc->localarg[i];
+            MPI_Get_address((void *)zeros, &displ[nblocks]);
+            blocklen[nblocks++] = TORC_PAYLOAD_ALIGN - bytes[k] % TORC_PAYLOAD_ALIGN;
         }
-
-#if DEBUG
-        printf("read+++ arg %d (%d - %d)\n", i, desc->quantity[i], desc->callway[i]);
-        fflush(0);
-#endif
     }
-}
 
-void receive_descriptor(int node, torc_t *desc)
-{
     MPI_Request request;
 
-    int istat;
-    int const tag = _torc_thread_id() + 100;
-
-    if (thread_safe)
+    enter_comm_cs();
+    if (nblocks == 1)
     {
-        istat = MPI_Irecv(desc, torc_size, MPI_CHAR, node, tag, comm_out, &request);
-        MPI_Wait(&request, MPI_STATUS_IGNORE);
+        MPI_Isend(desc, blocklen[0], MPI_BYTE, node, tag, comm_out, &request);
     }
     else
     {
-        /* irecv for non thread-safe MPI libraries */
-        int flag = 0;
+        MPI_Datatype msgtype;
+        MPI_Type_create_hindexed(nblocks, blocklen, displ, MPI_BYTE, &msgtype);
+        MPI_Type_commit(&msgtype);
 
-        enter_comm_cs();
-        istat = MPI_Irecv(desc, torc_size, MPI_CHAR, node, tag, comm_out, &request);
-        leave_comm_cs();
+        MPI_Isend(MPI_BOTTOM, 1, msgtype, node, tag, comm_out, &request);
 
-        while (1)
-        {
-            if (appl_finished == 1)
-            {
-                desc->type = TORC_NO_WORK;
-                return;
-            }
+        //! freed by MPI once the send completes
+        MPI_Type_free(&msgtype);
+    }
+    if (cb == NULL)
+    {
+        MPI_Wait(&request, MPI_STATUS_IGNORE);
+    }
+    leave_comm_cs();
 
-            enter_comm_cs();
-            istat = MPI_Test(&request, &flag, MPI_STATUS_IGNORE);
-            leave_comm_cs();
+    if (cb != NULL)
+    {
+        torc_progress_post(request, cb, arg);
+    }
+}
+
+/**
+ * @brief Size in bytes of the message of a descriptor
+ *
+ * @param desc TORC descriptor
+ * @param what TORC_PACK_HEADER, TORC_PACK_ARGUMENTS or TORC_PACK_RESULTS
+ * @return size_t
+ */
+static size_t packed_size(torc_t *desc, int what)
+{
+    void *addr[MAX_TORC_ARGS];
+    size_t bytes[MAX_TORC_ARGS];
+
+    int const npayloads = torc_payloads(desc, what, addr, bytes);
+
+    size_t size = TORC_DESC_SIZE(desc->narg);
+    for (int k = 0; k < npayloads; k++)
+    {
+        size += torc_payload_align(bytes[k]);
+    }
+
+    return size;
+}
+
+/**
+ * @brief Copy the message of a descriptor to a buffer, in the layout of send_packed
+ *
+ * @param out  Buffer of at least packed_size(desc, what) bytes
+ * @param desc TORC descriptor
+ * @param what TORC_PACK_HEADER, TORC_PACK_ARGUMENTS or TORC_PACK_RESULTS
+ */
+static void pack_descriptor(char *out, torc_t *desc, int what)
+{
+    void *addr[MAX_TORC_ARGS];
+    size_t bytes[MAX_TORC_ARGS];
+
+    int const npayloads = torc_payloads(desc, what, addr, bytes);
+
+    memcpy(out, desc, TORC_DESC_SIZE(desc->narg));
+    out += TORC_DESC_SIZE(desc->narg);
+
+    for (int k = 0; k < npayloads; k++)
+    {
+        size_t const padded = torc_payload_align(bytes[k]);
+
+        memcpy(out, addr[k], bytes[k]);
+        memset(out + bytes[k], 0, padded - bytes[k]);
+        out += padded;
+    }
+}
+
+/**
+ * @brief Completion callback of a posted descriptor: return it to the pool
+ *
+ * @param arg TORC descriptor
+ */
+static void torc_release_desc(void *arg)
+{
+    torc_t *desc = (torc_t *)arg;
+
+    free(desc->payload);
+    desc->payload = NULL;
+
+    _torc_put_reused_desc(desc);
+}
+
+/**
+ * @brief Send a descriptor to the server thread of node
+ *
+ * @param node Rank of destination node
+ * @param desc TORC descriptor
+ * @param type Request type
+ * @param cb   Completion callback, NULL for a blocking send
+ * @param arg  Argument of the callback
+ */
+static void _send_descriptor(int node, torc_t *desc, int type, torc_progress_cb cb, void *arg)
+{
+    int const tag = _torc_thread_id();
+
+#if DEBUG
+    printf("[%d] - sending to node [%d] desc -> homenode [%d], type = %d\n", torc_node_id(), node, desc->homenode, type);
+    fflush(0);
+#endif
+
+    desc->sourcenode = torc_node_id();
+    //! who sends this
+    desc->sourcevpid = tag;
+    desc->type = type;
+    desc->work_hint = (torc_i_rq_size(1) > 0);
+
+    switch (desc->type)
+    {
+    case TORC_STEAL_REQUEST:
+    case TORC_BCAST:
+    case TORC_BCAST_DONE:
+    case TORC_REDUCE:
+    case TORC_GATHER:
+        send_packed(node, MAX_NVPS, desc, TORC_PACK_HEADER, cb, arg);
+        return;
+        break;
+    case TORC_ANSWER:
+        /* in case of call by reference send the data back */
+        send_packed(node, MAX_NVPS, desc, TORC_PACK_RESULTS, cb, arg);
+        return;
+        break;
+    //! TORC_NORMAL_ENQUEUE
+    default:
+        send_packed(node, MAX_NVPS, desc, (desc->homenode == node) ? TORC_PACK_HEADER : TORC_PACK_ARGUMENTS, cb, arg);
+        return;
+        break;
+    }
+}
+
+/**
+ * \defgroup Aggregation
+ * Remote enqueues and answers are batched per destination node. A batch is a descriptor of
+ * type TORC_BATCH whose first argument holds the total length of the message,
+ * followed by the entries: the length of the message of a descriptor and the
+ * message itself (the layout of send_packed), padded to TORC_PAYLOAD_ALIGN bytes.
+ * A batch is sent when it reaches aggr_bytes, when its first entry is older than
+ * aggr_usecs, or when torc_aggr_flush is called (e.g. by torc_waitall).
+ */
+/**@{*/
+
+//! Space of the batch header
+#define TORC_BATCH_HEADER TORC_DESC_SIZE(1)
+
+/**
+ * @brief Completion callback of a batch: free the buffer
+ *
+ * @param arg batch buffer
+ */
+static void torc_release_batch(void *arg)
+{
+    free(arg);
+}
+
+/**
+ * @brief Write the header of a batch
+ *
+ * @param buf   batch
+ * @param len   length of the batch, header included
+ * @param count number of entries
+ */
+static void batch_seal(char *buf, size_t len, int count)
+{
+    torc_t *batch = (torc_t *)buf;
+
+    memset(batch, 0, TORC_BATCH_HEADER);
+    batch->narg = 1;
+    batch->homenode = torc_node_id();
+    batch->sourcenode = torc_node_id();
+    batch->sourcevpid = _torc_thread_id();
+    batch->type = TORC_BATCH;
+    batch->work_hint = (torc_i_rq_size(1) > 0);
+    batch->arg[0].localarg = len;
+    batch->arg[0].temparg = count;
+}
+
+/**
+ * @brief Append the message of a descriptor to a batch
+ *
+ * @param out  end of the batch
+ * @param desc TORC descriptor
+ * @param what TORC_PACK_HEADER, TORC_PACK_ARGUMENTS or TORC_PACK_RESULTS
+ * @param size packed_size(desc, what)
+ * @return size_t space taken by the entry
+ */
+static size_t batch_append(char *out, torc_t *desc, int what, size_t size)
+{
+    *(INT64 *)out = size;
+    pack_descriptor(out + sizeof(INT64), desc, what);
+
+    return sizeof(INT64) + torc_payload_align(size);
+}
 
-            if (flag == 1)
+/**
+ * @brief Send the batch of a node, the caller holds the lock of the buffer
+ *
+ * @param node Rank of destination node
+ */
+static void torc_aggr_send(int node)
+{
+    torc_aggr_t *a = &aggr[node];
+
+    batch_seal(a->buf, a->len, a->count);
+
+    if (torc_shm_send(node, a->buf, a->len))
+    {
+        torc_release_batch(a->buf);
+    }
+    else
+    {
+        MPI_Request request;
+
+        enter_comm_cs();
+        MPI_Isend(a->buf, (int)a->len, MPI_BYTE, node, MAX_NVPS, comm_out, &request);
+        leave_comm_cs();
+
+        torc_progress_post(request, torc_release_batch, a->buf);
+    }
+
+    a->buf = NULL;
+    a->len = 0;
+    a->count = 0;
+
+    __sync_fetch_and_sub(&aggr_nonempty, 1);
+}
+
+/**
+ * @brief Append a remote enqueue or an answer to the batch of the target node
+ * Descriptors larger than the batch threshold are sent on their own. In both
+ * cases desc is returned to the pool (once it has been sent).
+ *
+ * @param node Rank of destination node
+ * @param desc TORC descriptor taken from the pool
+ * @param type \b TORC_NORMAL_ENQUEUE or \b TORC_ANSWER
+ */
+static void aggregate_descriptor(int node, torc_t *desc, int type)
+{
+    int what;
+    if (type == TORC_ANSWER)
+    {
+        what = TORC_PACK_RESULTS;
+    }
+    else
+    {
+        what = (desc->homenode == node) ? TORC_PACK_HEADER : TORC_PACK_ARGUMENTS;
+    }
+
+    size_t const size = packed_size(desc, what);
+    size_t const space = sizeof(INT64) + torc_payload_align(size);
+
+    if (space > (size_t)aggr_bytes)
+    {
+        _send_descriptor(node, desc, type, torc_release_desc, desc);
+        return;
+    }
+
+    desc->sourcenode = torc_node_id();
+    desc->sourcevpid = _torc_thread_id();
+    desc->type = type;
+
+    torc_aggr_t *a = &aggr[node];
+
+    _lock_acquire(&a->lock);
+    if (a->buf == NULL)
+    {
+        //! the batch is sent once it exceeds aggr_bytes, so the last entry always fits
+        a->buf = (char *)malloc(TORC_BATCH_HEADER + 2 * (size_t)aggr_bytes);
+        a->len = TORC_BATCH_HEADER;
+        a->count = 0;
+        a->t0 = torc_gettime();
+
+        __sync_fetch_and_add(&aggr_nonempty, 1);
+    }
+
+    a->len += batch_append(a->buf + a->len, desc, what, size);
+    a->count++;
+
+    if (a->len - TORC_BATCH_HEADER >= (size_t)aggr_bytes)
+    {
+        torc_aggr_send(node);
+    }
+    _lock_release(&a->lock);
+
+    //! the entry is a copy
+    torc_release_desc(desc);
+}
+
+/**
+ * @brief Send the pending batches
+ *
+ * @param expired Send only the batches older than aggr_usecs
+ */
+void torc_aggr_flush(int expired)
+{
+    if (aggr_nonempty == 0)
+    {
+        return;
+    }
+
+    double const now = expired ? torc_gettime() : 0;
+
+    for (int node = 0; node < torc_num_nodes(); node++)
+    {
+        torc_aggr_t *a = &aggr[node];
+
+        if (a->buf == NULL)
+        {
+            continue;
+        }
+
+        _lock_acquire(&a->lock);
+        if ((a->buf != NULL) && (!expired || (now - a->t0) * 1.0E6 >= aggr_usecs))
+        {
+            torc_aggr_send(node);
+        }
+        _lock_release(&a->lock);
+    }
+}
+
+/**
+ * @brief Number of non-empty batches
+ *
+ * @return int
+ */
+int torc_aggr_pending()
+{
+    return aggr_nonempty;
+}
+
+/**@}*/
+
+/**
+ * @brief Sending descriptor
+ * Send a descriptor to the target node - always to a server thread.
+ * The call returns when desc can be reused (e.g. a stack variable)
+ * 
+ * @param node Rank of destination node 
+ * @param desc TORC descriptor 
+ * @param type Request type, which is one of 
+ *      \b TORC_STEAL_REQUEST
+ *      \b TORC_BCAST
+ *      \b TORC_ANSWER
+ *      \b TORC_NORMAL_ENQUEUE
+ */
+void send_descriptor(int node, torc_t *desc, int type)
+{
+    _send_descriptor(node, desc, type, NULL, NULL);
+
+    if (type == TORC_ANSWER)
+    {
+        //! the local copies of the arguments
+        free(desc->payload);
+        desc->payload = NULL;
+    }
+}
+
+/**
+ * @brief Post a descriptor to the target node and continue
+ * The progress engine returns desc (and its payload) to the pool once it has been sent.
+ * Unless aggr_bytes is 0, the descriptor travels in the batch of the node.
+ *
+ * @param node Rank of destination node
+ * @param desc TORC descriptor taken from the pool
+ * @param type Request type (\b TORC_NORMAL_ENQUEUE, \b TORC_ANSWER or \b TORC_STEAL_REQUEST)
+ */
+void post_descriptor(int node, torc_t *desc, int type)
+{
+    if ((aggr_bytes > 0) && ((type == TORC_NORMAL_ENQUEUE) || (type == TORC_ANSWER)))
+    {
+        aggregate_descriptor(node, desc, type);
+        return;
+    }
+
+    _send_descriptor(node, desc, type, torc_release_desc, desc);
+}
+
+/**
+ * @brief Post the reply to a stealing request and continue
+ * The stolen descriptors travel as a batch of type TORC_STEAL_REPLY, without
+ * entries if there is no work. They are copied into the batch and returned to the pool.
+ *
+ * @param node  Rank of the thief
+ * @param vp    Thread of the thief that asked for work
+ * @param descs Stolen TORC descriptors
+ * @param n     Number of descriptors
+ */
+void post_steal_reply(int node, int vp, torc_t **descs, int n)
+{
+    int what[TORC_STEAL_CHUNK_MAX];
+    size_t size[TORC_STEAL_CHUNK_MAX];
+
+    size_t len = TORC_BATCH_HEADER;
+    for (int k = 0; k < n; k++)
+    {
+        what[k] = (descs[k]->homenode == node) ? TORC_PACK_HEADER : TORC_PACK_ARGUMENTS;
+        size[k] = packed_size(descs[k], what[k]);
+        len += sizeof(INT64) + torc_payload_align(size[k]);
+    }
+
+    char *buf = (char *)malloc(len);
+
+    char *out = buf + TORC_BATCH_HEADER;
+    for (int k = 0; k < n; k++)
+    {
+        descs[k]->sourcenode = torc_node_id();
+        descs[k]->sourcevpid = MAX_NVPS;
+        descs[k]->type = TORC_NORMAL_ENQUEUE;
+
+        out += batch_append(out, descs[k], what[k], size[k]);
+
+        torc_release_desc(descs[k]);
+    }
+
+    batch_seal(buf, len, n);
+
+    torc_t *reply = (torc_t *)buf;
+    reply->type = TORC_STEAL_REPLY;
+    reply->target_queue = vp;
+
+    if (torc_shm_send(node, buf, len))
+    {
+        torc_release_batch(buf);
+        return;
+    }
+
+    MPI_Request request;
+
+    enter_comm_cs();
+    MPI_Isend(buf, (int)len, MPI_BYTE, node, MAX_NVPS, comm_out, &request);
+    leave_comm_cs();
+
+    torc_progress_post(request, torc_release_batch, buf);
+}
+
+/**
+ * @brief Copy a ready task to a slot of the stealing window of this node
+ * The thief is not known yet: the arguments always travel with the task and
+ * the owner node ignores them when it takes the task back or steals it
+ *
+ * @param out  slot
+ * @param room size of the slot
+ * @param desc TORC descriptor, released once copied
+ * @return size_t length of the message, 0 if it does not fit (desc is kept)
+ */
+size_t pack_published(char *out, size_t room, torc_t *desc)
+{
+    size_t const size = packed_size(desc, TORC_PACK_ARGUMENTS);
+    if (size > room)
+    {
+        return 0;
+    }
+
+    desc->sourcenode = torc_node_id();
+    desc->sourcevpid = MAX_NVPS;
+    desc->type = TORC_NORMAL_ENQUEUE;
+
+    pack_descriptor(out, desc, TORC_PACK_ARGUMENTS);
+
+    torc_release_desc(desc);
+
+    return size;
+}
+
+/**
+ * @brief Unpack the arguments that travelled with a task
+ * All the arguments that need local memory share one allocated block (desc->payload)
+ *
+ * @param desc TORC descriptor
+ */
+void unpack_arguments(torc_t *desc)
+{
+    char *msg = (desc->payload != NULL) ? (char *)desc->payload : (char *)desc;
+    char *in = msg + TORC_DESC_SIZE(desc->narg);
+
+    size_t total = 0;
+    for (int i = 0; i < desc->narg; i++)
+    {
+        torc_arg_t *a = &desc->arg[i];
+        if (torc_arg_needs_temp(a))
+        {
+            a->dtype = _torc_b2mpi_type(a->btype);
+            total += torc_payload_align(torc_arg_bytes(a));
+        }
+    }
+
+    char *mem = (total > 0) ? (char *)malloc(total) : NULL;
+    char *out = mem;
+
+    for (int i = 0; i < desc->narg; i++)
+    {
+        torc_arg_t *a = &desc->arg[i];
+
+#if DEBUG
+        printf("reading arg %d (%d - %d)\n", i, a->quantity, a->callway);
+        fflush(0);
+#endif
+        if (a->quantity == 0)
+        {
+            continue;
+        }
+
+        if (torc_arg_needs_temp(a))
+        {
+            size_t const bytes = torc_arg_bytes(a);
+
+            a->temparg = (INT64)out;
+            //! CALL_BY_REF
+            if (a->callway != CALL_BY_RES)
             {
-                break;
+                memcpy(out, in, bytes);
+                in += torc_payload_align(bytes);
             }
             else
             {
-                thread_sleep(yieldtime);
+                memset(out, 0, bytes);
             }
+            out += torc_payload_align(bytes);
+        }
+        else
+        {
+            a->temparg = a->localarg;
         }
     }
 
-    if (istat != MPI_SUCCESS)
+    free(desc->payload);
+    desc->payload = mem;
+}
+
+/**
+ * @brief Copy the results of an answer to their addresses in the owner node
+ *
+ * @param desc TORC descriptor
+ */
+void unpack_results(torc_t *desc)
+{
+    char *msg = (desc->payload != NULL) ? (char *)desc->payload : (char *)desc;
+    char *in = msg + TORC_DESC_SIZE(desc->narg);
+
+    for (int i = 0; i < desc->narg; i++)
     {
-        desc->type = TORC_NO_WORK;
-        return;
+        torc_arg_t *a = &desc->arg[i];
+        if (torc_arg_result(a))
+        {
+            a->dtype = _torc_b2mpi_type(a->btype);
+
+            size_t const bytes = torc_arg_bytes(a);
+
+            memcpy((void *)a->localarg, in, bytes);
+            in += torc_payload_align(bytes);
+        }
+    }
+
+    free(desc->payload);
+    desc->payload = NULL;
+}
+
+/**
+ * @brief Number of argument records that hold a message of count bytes
+ *
+ */
+static inline int torc_message_nrec(size_t count)
+{
+    return (count - TORC_DESC_SIZE(0) + sizeof(torc_arg_t) - 1) / sizeof(torc_arg_t);
+}
+
+/**
+ * @brief Receive a probed message into a pool descriptor of the matching size class
+ * Small messages are received in place: the payloads, if any, follow the argument
+ * records inside the descriptor. Larger ones go through a buffer kept in desc->payload
+ * until they are unpacked.
+ *
+ * @param status Status of the probed message
+ * @param tag    Message tag
+ * @return torc_t* received descriptor
+ */
+torc_t *receive_probed_descriptor(MPI_Status *status, int tag)
+{
+    int count;
+    MPI_Get_count(status, MPI_BYTE, &count);
+
+    if (count < (int)TORC_DESC_SIZE(0))
+    {
+        Error1("Truncated descriptor from node %d", status->MPI_SOURCE);
     }
 
-    if (desc->type == TORC_NO_WORK)
+    int const nrec = torc_message_nrec(count);
+
+    torc_t *desc;
+    char *msg = NULL;
+
+    if (nrec <= MAX_TORC_ARGS)
     {
-        return;
+        desc = _torc_get_reused_desc(nrec);
+
+        //! the sender's size class is overwritten
+        int const sclass = desc->sclass;
+
+        enter_comm_cs();
+        MPI_Recv(desc, count, MPI_BYTE, status->MPI_SOURCE, tag, comm_out, MPI_STATUS_IGNORE);
+        leave_comm_cs();
+
+        desc->sclass = sclass;
+    }
+    else
+    {
+        msg = (char *)malloc(count);
+
+        enter_comm_cs();
+        MPI_Recv(msg, count, MPI_BYTE, status->MPI_SOURCE, tag, comm_out, MPI_STATUS_IGNORE);
+        leave_comm_cs();
+
+        int const narg = ((torc_t *)msg)->narg;
+
+        desc = _torc_get_reused_desc(narg);
+
+        int const sclass = desc->sclass;
+
+        memcpy(desc, msg, TORC_DESC_SIZE(narg));
+
+        desc->sclass = sclass;
+    }
+
+    desc->payload = msg;
+
+    return desc;
+}
+
+/**
+ * @brief Copy a message into a pool descriptor of the matching size class
+ * The descriptor is laid out as in receive_probed_descriptor
+ *
+ * @param in    message (e.g. in the shared-memory ring)
+ * @param count length of the message
+ * @return torc_t* received descriptor
+ */
+torc_t *receive_buffered_descriptor(char const *in, size_t count)
+{
+    int const nrec = torc_message_nrec(count);
+    int const narg = ((torc_t const *)in)->narg;
+
+    torc_t *desc = _torc_get_reused_desc((nrec <= MAX_TORC_ARGS) ? nrec : narg);
+
+    int const sclass = desc->sclass;
+
+    if (nrec <= MAX_TORC_ARGS)
+    {
+        memcpy(desc, in, count);
+        desc->payload = NULL;
+    }
+    else
+    {
+        memcpy(desc, in, TORC_DESC_SIZE(narg));
+        desc->payload = malloc(count);
+        memcpy(desc->payload, in, count);
+    }
+
+    desc->sclass = sclass;
+
+    return desc;
+}
+
+/**
+ * @brief Extract the next descriptor of a received batch
+ * The descriptor is laid out as if it had been received on its own
+ * (see receive_probed_descriptor)
+ *
+ * @param batch  Received TORC_BATCH descriptor
+ * @param cursor Position in the batch, NULL before the first call
+ * @return torc_t* descriptor, or NULL after the last one
+ */
+torc_t *unpack_batch(torc_t *batch, char **cursor)
+{
+    char *msg = (batch->payload != NULL) ? (char *)batch->payload : (char *)batch;
+    char *end = msg + batch->arg[0].localarg;
+
+    if (*cursor == NULL)
+    {
+        *cursor = msg + TORC_DESC_SIZE(batch->narg);
     }
 
-    //! homenode == torc_node_id() -> the descriptor is stolen by its owner node
-    if (desc->homenode != torc_node_id())
+    if (*cursor >= end)
     {
-        receive_arguments(desc, tag);
+        return NULL;
     }
 
-    return;
+    size_t const count = *(INT64 *)*cursor;
+    char *in = *cursor + sizeof(INT64);
+
+    *cursor = in + torc_payload_align(count);
+
+    return receive_buffered_descriptor(in, count);
 }
+
 /**@}*/
 
 /**
@@ -579,57 +1364,6 @@ int global_thread_id_to_local_thread_id(int global_thread_id)
 
 /**@}*/
 
-/**
- * \defgroup BROADCASTING
- */
-/**@{*/
-
-/**
- * @brief Broadcasts a message from the process with rank of the current processor to all other processes of the group. 
- * 
- * @param buffer   Starting address of buffer 
- * @param count    Number of entries in buffer
- * @param datatype Data type of buffer
- */
-void torc_broadcast(void *buffer, long count, MPI_Datatype datatype)
-{
-#if DEBUG
-    printf("Broadcasting data ...\n");
-    fflush(0);
-#endif
-
-    static unsigned long torc_size = sizeof(torc_t);
-
-    torc_t mydata;
-    memset(&mydata, 0, torc_size);
-
-    int const mynode = torc_node_id();
-
-    mydata.homenode = mynode;
-    mydata.sourcenode = mynode;
-
-    mydata.localarg[0] = (INT64)mynode;
-    mydata.localarg[1] = (INT64)buffer;
-    mydata.localarg[2] = (INT64)count;
-    mydata.localarg[3] = (INT64)_torc_mpi2b_type(datatype);
-
-    int const tag = _torc_thread_id();
-    for (int node = 0; node < torc_num_nodes(); node++)
-    {
-        if (node != mynode)
-        {
-            /* OK. This descriptor is a stack variable */
-            send_descriptor(node, &mydata, TORC_BCAST);
-
-            enter_comm_cs();
-            MPI_Ssend(buffer, count, datatype, node, tag, comm_out);
-            leave_comm_cs();
-        }
-    }
-}
-
-/**@}*/
-
 /**
  * \defgroup Data types
  */
@@ -0,0 +1,234 @@
+/*
+ *  torc_dataflow.c
+ *  TORC_Lite
+ *
+ *  Created by Panagiotis Hadjidoukas on 1/1/14.
+ *  Copyright 2014 ETH Zurich. All rights reserved.
+ *
+ */
+#include <torc_internal.h>
+#include <torc.h>
+
+/**
+ * \defgroup Dataflow
+ * In dataflow mode (torc_enable_dataflow) the tasks created with torc_task or
+ * torc_task_future on a node are ordered by the memory regions of their
+ * arguments, given by the address and quantity of each argument:
+ * - CALL_BY_COP, CALL_BY_COP2, CALL_BY_PTR and CALL_BY_VAD read (IN);
+ * - CALL_BY_RES writes (OUT) and CALL_BY_REF reads and writes (INOUT).
+ * A task that reads a region written by an unfinished task, or writes a
+ * region accessed by an unfinished task, is held back until that task has
+ * finished. Arguments passed by copy are copied when the task is created,
+ * like outside dataflow mode: only the arguments passed by pointer or by
+ * reference see the output of the tasks they depend on.
+ * The node keeps the regions of its unfinished tracked tasks in one table.
+ */
+/**@{*/
+
+//! Initial capacity of the table and of the successor lists
+#define TORC_DF_CHUNK 64
+
+/**
+ * @brief Region accessed by an unfinished task
+ *
+ */
+typedef struct
+{
+    char *start;
+    char *end;
+    int write;
+    torc_future_t *task;
+} torc_access_t;
+
+static struct
+{
+    //! protects the table and the dependencies of the tracked tasks
+    pthread_mutex_t m;
+    torc_access_t *accesses;
+    int n;
+    int max;
+} df = {PTHREAD_MUTEX_INITIALIZER};
+
+/**
+ * @brief Order the tasks created from now on by their arguments
+ *
+ */
+void torc_enable_dataflow()
+{
+    dataflow = 1;
+}
+
+/**
+ * @brief Stop ordering new tasks, the tracked ones keep their dependencies
+ *
+ */
+void torc_disable_dataflow()
+{
+    dataflow = 0;
+}
+
+/**
+ * @brief Make task a successor of pred, the caller holds df.m
+ *
+ */
+static void add_successor(torc_future_t *pred, torc_future_t *task)
+{
+    if (pred->nsucc == pred->maxsucc)
+    {
+        pred->maxsucc = (pred->maxsucc == 0) ? TORC_DF_CHUNK : 2 * pred->maxsucc;
+        pred->succ = (torc_future_t **)realloc(pred->succ, pred->maxsucc * sizeof(torc_future_t *));
+    }
+    pred->succ[pred->nsucc++] = task;
+
+    task->npred++;
+}
+
+/**
+ * @brief Add a region to the table, the caller holds df.m
+ *
+ */
+static void add_access(char *start, char *end, int write, torc_future_t *task)
+{
+    if (df.n == df.max)
+    {
+        df.max = (df.max == 0) ? TORC_DF_CHUNK : 2 * df.max;
+        df.accesses = (torc_access_t *)realloc(df.accesses, df.max * sizeof(torc_access_t));
+    }
+
+    torc_access_t *a = &df.accesses[df.n++];
+    a->start = start;
+    a->end = end;
+    a->write = write;
+    a->task = task;
+}
+
+/**
+ * @brief Enqueue a task whose predecessors have finished
+ *
+ */
+static void release(torc_future_t *task)
+{
+    torc_t *desc = task->desc;
+
+    task->desc = NULL;
+
+    if (task->queue == -1)
+    {
+        torc_to_rq_end(desc);
+    }
+    else
+    {
+        torc_to_lrq_end(task->queue, desc);
+    }
+}
+
+/**
+ * @brief Record the regions of a new task and find the unfinished tasks it depends on
+ *
+ * @param desc    TORC descriptor, its arguments already copied in
+ * @param queue   target queue of the task (-1: any)
+ * @param regions addresses of the arguments given to the task
+ * @return int 1 if the task is held back, 0 if the caller must enqueue it
+ */
+int _torc_dataflow_register(torc_t *desc, int queue, VIRT_ADDR const *regions)
+{
+    torc_future_t *task = desc->future;
+
+    if (task == NULL)
+    {
+        task = (torc_future_t *)calloc(1, sizeof(torc_future_t));
+        atomic_init(&task->done, 0);
+        task->vp_id = -1;
+        desc->future = task;
+    }
+
+    task->tracked = 1;
+    task->queue = queue;
+    task->desc = desc;
+
+    pthread_mutex_lock(&df.m);
+
+    int const n = df.n;
+
+    for (int i = 0; i < desc->narg; i++)
+    {
+        if (desc->arg[i].quantity == 0)
+        {
+            continue;
+        }
+
+        int typesize;
+        MPI_Type_size(desc->arg[i].dtype, &typesize);
+
+        char *start = (char *)regions[i];
+        char *end = start + (long)desc->arg[i].quantity * typesize;
+        int const write = (desc->arg[i].callway == CALL_BY_REF) || (desc->arg[i].callway == CALL_BY_RES);
+
+        //! the regions of the task itself are not checked against each other
+        for (int k = 0; k < n; k++)
+        {
+            torc_access_t *a = &df.accesses[k];
+
+            if ((a->start < end) && (start < a->end) && (write || a->write))
+            {
+                //! one edge per predecessor is enough
+                if ((a->task->nsucc == 0) || (a->task->succ[a->task->nsucc - 1] != task))
+                {
+                    add_successor(a->task, task);
+                }
+            }
+        }
+
+        add_access(start, end, write, task);
+    }
+
+    int const held = (task->npred > 0);
+
+    pthread_mutex_unlock(&df.m);
+
+    return held;
+}
+
+/**
+ * @brief A tracked task has finished: drop its regions and release its successors
+ *
+ * @param task completion record of the task
+ */
+void _torc_dataflow_complete(torc_future_t *task)
+{
+    pthread_mutex_lock(&df.m);
+
+    int n = 0;
+    for (int k = 0; k < df.n; k++)
+    {
+        if (df.accesses[k].task != task)
+        {
+            df.accesses[n++] = df.accesses[k];
+        }
+    }
+    df.n = n;
+
+    //! the successors that become ready are kept in place
+    int nready = 0;
+    for (int k = 0; k < task->nsucc; k++)
+    {
+        if (--task->succ[k]->npred == 0)
+        {
+            task->succ[nready++] = task->succ[k];
+        }
+    }
+
+    pthread_mutex_unlock(&df.m);
+
+    for (int k = 0; k < nready; k++)
+    {
+        release(task->succ[k]);
+    }
+
+    free(task->succ);
+    task->succ = NULL;
+    task->nsucc = 0;
+    task->maxsucc = 0;
+}
+
+/**@}*/
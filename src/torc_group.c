@@ -0,0 +1,388 @@
+/*
+ *  torc_group.c
+ *  TORC_Lite
+ *
+ *  Created by Panagiotis Hadjidoukas on 1/1/14.
+ *  Copyright 2014 ETH Zurich. All rights reserved.
+ *
+ */
+#include <torc_internal.h>
+#include <torc.h>
+
+/**
+ * \defgroup Task groups
+ * The tasks that a task creates between torc_taskgroup_begin and
+ * torc_taskgroup_end belong to the group, and so do their descendants on any
+ * node: a descriptor carries the node and the id of its group and passes them
+ * on to the tasks it creates. The members created on the node of the group
+ * are counted, torc_taskgroup_wait waits for them only.
+ *
+ * torc_taskgroup_cancel marks the group cancelled on all the nodes. A queued
+ * task of a cancelled group is dropped when a worker dequeues it: it is not
+ * executed, its results are not copied back, and its parent, future and group
+ * are notified as if it had finished. A running task polls
+ * torc_taskgroup_cancelled.
+ *
+ * A node remembers every group cancelled on it, in a set of (node, id) that
+ * grows as needed: a member may be dequeued long after its group has been
+ * cancelled. The set is read without locking: a grown table is published
+ * through one pointer and the tables it replaces are kept until
+ * torc_finalize.
+ */
+/**@{*/
+
+//! Maximum number of open groups of a node
+#define TORC_MAX_GROUPS 1024
+
+//! Initial capacity of the set of cancelled groups
+#define TORC_CANCELLED_GROUPS 256
+
+//! Key of a group in the set of cancelled groups, never 0 as the ids start at 1
+#define TORC_GROUP_KEY(node, id) (((unsigned long)(unsigned int)(node) << 32) | (unsigned int)(id))
+
+//! Table of the set of cancelled groups: open addressing (linear probing), at most half full
+typedef struct torc_cancelled_set
+{
+    //! capacity - 1
+    unsigned long mask;
+    //! keys in use
+    unsigned long n;
+    //! previously used (retired) table
+    struct torc_cancelled_set *retired;
+    _Atomic(unsigned long) keys[];
+} torc_cancelled_set_t;
+
+struct torc_taskgroup
+{
+    int id;
+    //! members not finished yet
+    atomic_int pending;
+    //! worker of the owner, woken up when the last member finishes
+    long vp_id;
+    //! the task that opened the group and the group it was in
+    torc_t *owner;
+    int outer_node;
+    int outer_id;
+    int open;
+};
+
+static struct
+{
+    //! protects the open groups and the updates of the cancelled ones
+    pthread_mutex_t m;
+    //! open groups of the node, by id
+    struct torc_taskgroup *groups[TORC_MAX_GROUPS];
+    int last_id;
+    //! cancelled groups, NULL until the first cancellation
+    _Atomic(torc_cancelled_set_t *) cancelled;
+} tg = {PTHREAD_MUTEX_INITIALIZER};
+
+/**
+ * @brief Open a group: the tasks created from now on by the calling task belong to it
+ *
+ * @return torc_group_t group, released by torc_taskgroup_wait
+ */
+torc_group_t torc_taskgroup_begin()
+{
+    torc_t *self = _torc_self();
+
+    struct torc_taskgroup *group = (struct torc_taskgroup *)calloc(1, sizeof(struct torc_taskgroup));
+
+    pthread_mutex_lock(&tg.m);
+    //! ids are not reused until they wrap around
+    int id = tg.last_id;
+    int tries = 0;
+    do
+    {
+        id = (id == 0x7fffffff) ? 1 : id + 1;
+    } while ((tg.groups[id % TORC_MAX_GROUPS] != NULL) && (++tries < TORC_MAX_GROUPS));
+
+    if (tg.groups[id % TORC_MAX_GROUPS] != NULL)
+    {
+        pthread_mutex_unlock(&tg.m);
+        Error("too many open task groups");
+    }
+    tg.last_id = id;
+    tg.groups[id % TORC_MAX_GROUPS] = group;
+    pthread_mutex_unlock(&tg.m);
+
+    group->id = id;
+    atomic_init(&group->pending, 0);
+    group->vp_id = self->vp_id;
+    group->owner = self;
+    group->outer_node = self->group_node;
+    group->outer_id = self->group_id;
+    group->open = 1;
+
+    self->group_node = torc_node_id();
+    self->group_id = id;
+
+    return group;
+}
+
+/**
+ * @brief Close a group: the tasks created from now on do not belong to it
+ *
+ * @param group
+ */
+void torc_taskgroup_end(torc_group_t group)
+{
+    if (!group->open)
+    {
+        return;
+    }
+
+    group->owner->group_node = group->outer_node;
+    group->owner->group_id = group->outer_id;
+    group->open = 0;
+}
+
+/**
+ * @brief Wait for the members of a group, executing other tasks meanwhile
+ * The group is closed, if still open, and released
+ *
+ * @param group
+ */
+void torc_taskgroup_wait(torc_group_t group)
+{
+    torc_taskgroup_end(group);
+
+    if (atomic_load_explicit(&group->pending, memory_order_acquire) > 0)
+    {
+        //! the members may be waiting in the batches of remote enqueues
+        torc_aggr_flush(0);
+
+        while (atomic_load_explicit(&group->pending, memory_order_acquire) > 0)
+        {
+            _torc_scheduler_loop(1);
+        }
+    }
+
+    pthread_mutex_lock(&tg.m);
+    tg.groups[group->id % TORC_MAX_GROUPS] = NULL;
+    pthread_mutex_unlock(&tg.m);
+
+    free(group);
+}
+
+/**
+ * @brief Home slot of a group in the set of cancelled groups
+ *
+ */
+static inline unsigned long torc_group_hash(unsigned long key, unsigned long mask)
+{
+    return ((key * 0x9E3779B97F4A7C15UL) >> 32) & mask;
+}
+
+/**
+ * @brief Remember a cancelled group
+ *
+ * @param node node of the group
+ * @param id   id of the group
+ */
+void _torc_group_mark_cancelled(int node, int id)
+{
+    unsigned long const key = TORC_GROUP_KEY(node, id);
+
+    pthread_mutex_lock(&tg.m);
+    torc_cancelled_set_t *set = atomic_load_explicit(&tg.cancelled, memory_order_relaxed);
+
+    if ((set == NULL) || (2 * (set->n + 1) > set->mask + 1))
+    {
+        //! double the set and rehash into a new table, published once it is filled
+        unsigned long const size = (set == NULL) ? TORC_CANCELLED_GROUPS : 2 * (set->mask + 1);
+        torc_cancelled_set_t *grown = (torc_cancelled_set_t *)calloc(1, sizeof(torc_cancelled_set_t) + size * sizeof(_Atomic(unsigned long)));
+        if (grown == NULL)
+        {
+            pthread_mutex_unlock(&tg.m);
+            Error("out of memory while cancelling a task group");
+        }
+        grown->mask = size - 1;
+
+        for (unsigned long k = 0; (set != NULL) && (k <= set->mask); k++)
+        {
+            unsigned long const old = atomic_load_explicit(&set->keys[k], memory_order_relaxed);
+            if (old != 0)
+            {
+                unsigned long i = torc_group_hash(old, grown->mask);
+                while (atomic_load_explicit(&grown->keys[i], memory_order_relaxed) != 0)
+                {
+                    i = (i + 1) & grown->mask;
+                }
+                atomic_store_explicit(&grown->keys[i], old, memory_order_relaxed);
+                grown->n++;
+            }
+        }
+
+        //! readers may still probe the old table
+        grown->retired = set;
+        atomic_store_explicit(&tg.cancelled, grown, memory_order_release);
+        set = grown;
+    }
+
+    unsigned long i = torc_group_hash(key, set->mask);
+    unsigned long k;
+    while (((k = atomic_load_explicit(&set->keys[i], memory_order_relaxed)) != 0) && (k != key))
+    {
+        i = (i + 1) & set->mask;
+    }
+    if (k == 0)
+    {
+        set->n++;
+        atomic_store_explicit(&set->keys[i], key, memory_order_release);
+    }
+    pthread_mutex_unlock(&tg.m);
+
+    //! idle workers drop the queued members
+    _torc_wake_all();
+}
+
+/**
+ * @brief Cancel a group on all the nodes
+ * Queued members are dropped, running ones see torc_taskgroup_cancelled
+ *
+ * @param group
+ */
+void torc_taskgroup_cancel(torc_group_t group)
+{
+    int const mynode = torc_node_id();
+
+    _torc_group_mark_cancelled(mynode, group->id);
+
+    //! the members may be waiting in the batches of remote enqueues
+    torc_aggr_flush(0);
+
+    torc_ctl_t ctl;
+    memset(&ctl, 0, sizeof(ctl));
+
+    torc_t *mydata = &ctl.desc;
+
+    mydata->narg = 2;
+    mydata->arg[0].localarg = mynode;
+    mydata->arg[1].localarg = group->id;
+    mydata->homenode = mynode;
+
+    for (int node = 0; node < torc_num_nodes(); node++)
+    {
+        if (node != mynode)
+        {
+            //! OK. This descriptor is a stack variable
+            send_descriptor(node, mydata, TORC_GROUP_CANCEL);
+        }
+    }
+}
+
+/**
+ * @brief Check whether a group has been cancelled
+ *
+ * @param node node of the group
+ * @param id   id of the group
+ * @return int 1 if cancelled
+ */
+int _torc_group_cancelled(int node, int id)
+{
+    torc_cancelled_set_t *set = atomic_load_explicit(&tg.cancelled, memory_order_acquire);
+    if (set == NULL)
+    {
+        return 0;
+    }
+
+    unsigned long const key = TORC_GROUP_KEY(node, id);
+    unsigned long k;
+
+    for (unsigned long i = torc_group_hash(key, set->mask); (k = atomic_load_explicit(&set->keys[i], memory_order_acquire)) != 0; i = (i + 1) & set->mask)
+    {
+        if (k == key)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Release the set of cancelled groups and the tables it replaced
+ * Called at the end of torc_finalize, when no task is left to check it
+ *
+ */
+void _torc_group_end()
+{
+    torc_cancelled_set_t *set = atomic_exchange_explicit(&tg.cancelled, NULL, memory_order_relaxed);
+    while (set != NULL)
+    {
+        torc_cancelled_set_t *r = set->retired;
+        free(set);
+        set = r;
+    }
+}
+
+/**
+ * @brief Whether the group of the calling task has been cancelled
+ *
+ * @return int 1 if the task should stop
+ */
+int torc_taskgroup_cancelled()
+{
+    torc_t *self = _torc_self();
+
+    return self->group_id && _torc_group_cancelled(self->group_node, self->group_id);
+}
+
+/**
+ * @brief A new task joins the group of its creator
+ *
+ * @param self creator
+ * @param desc new task
+ */
+void _torc_group_join(torc_t *self, torc_t *desc)
+{
+    desc->group_node = self->group_node;
+    desc->group_id = self->group_id;
+
+    if ((desc->group_id == 0) || (desc->group_node != torc_node_id()))
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&tg.m);
+    struct torc_taskgroup *group = tg.groups[desc->group_id % TORC_MAX_GROUPS];
+    if ((group != NULL) && (group->id == desc->group_id))
+    {
+        atomic_fetch_add_explicit(&group->pending, 1, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&tg.m);
+}
+
+/**
+ * @brief A task of the node has finished or has been dropped
+ *
+ * @param desc TORC descriptor
+ */
+void _torc_group_done(torc_t *desc)
+{
+    if (desc->group_node != torc_node_id())
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&tg.m);
+    struct torc_taskgroup *group = tg.groups[desc->group_id % TORC_MAX_GROUPS];
+    if ((group == NULL) || (group->id != desc->group_id))
+    {
+        pthread_mutex_unlock(&tg.m);
+        return;
+    }
+
+    //! the owner may release the group as soon as pending drops to zero
+    long const vp = group->vp_id;
+    int const last = (atomic_fetch_sub_explicit(&group->pending, 1, memory_order_acq_rel) == 1);
+    pthread_mutex_unlock(&tg.m);
+
+    if (last)
+    {
+        _torc_wake_vp(vp);
+    }
+}
+
+/**@}*/
@@ -0,0 +1,189 @@
+/*
+ *  torc_progress.c
+ *  TORC_Lite
+ *
+ *  Created by Panagiotis Hadjidoukas on 1/1/14.
+ *  Copyright 2014 ETH Zurich. All rights reserved.
+ *
+ */
+#include <torc_internal.h>
+#include <torc.h>
+
+/**
+ * \defgroup Communication progress engine
+ * The engine owns the outstanding MPI requests of the node. A thread posts a
+ * request together with a completion callback and continues; the server thread
+ * and the idle workers complete the requests with MPI_Testsome.
+ */
+/**@{*/
+
+//! Maximum number of outstanding requests
+#ifndef TORC_PROGRESS_MAX
+#define TORC_PROGRESS_MAX 1024
+#endif
+
+static struct
+{
+    //! protects the request table
+    pthread_mutex_t m;
+    //! number of outstanding requests
+    volatile int n;
+    MPI_Request reqs[TORC_PROGRESS_MAX];
+    torc_progress_cb cbs[TORC_PROGRESS_MAX];
+    void *args[TORC_PROGRESS_MAX];
+} engine = {PTHREAD_MUTEX_INITIALIZER, 0};
+
+/**
+ * @brief Post an outstanding request
+ * cb(arg) is called by the thread that finds the request complete
+ *
+ * @param request MPI request
+ * @param cb      Completion callback (may be NULL)
+ * @param arg     Argument of the callback
+ */
+void torc_progress_post(MPI_Request request, torc_progress_cb cb, void *arg)
+{
+    while (1)
+    {
+        pthread_mutex_lock(&engine.m);
+        if (engine.n < TORC_PROGRESS_MAX)
+        {
+            engine.reqs[engine.n] = request;
+            engine.cbs[engine.n] = cb;
+            engine.args[engine.n] = arg;
+            engine.n++;
+            pthread_mutex_unlock(&engine.m);
+            return;
+        }
+        pthread_mutex_unlock(&engine.m);
+
+        //! the table is full, complete some requests first
+        if (!torc_progress())
+        {
+            sched_yield();
+        }
+    }
+}
+
+/**
+ * @brief Complete the finished outstanding requests and run their callbacks
+ * Only one thread polls at a time, the others return immediately
+ *
+ * @return int Number of completed requests
+ */
+int torc_progress()
+{
+    int indices[TORC_PROGRESS_MAX];
+    torc_progress_cb cbs[TORC_PROGRESS_MAX];
+    void *args[TORC_PROGRESS_MAX];
+
+    if (engine.n == 0)
+    {
+        return 0;
+    }
+
+    if (pthread_mutex_trylock(&engine.m) != 0)
+    {
+        return 0;
+    }
+
+    int outcount = 0;
+    if (engine.n > 0)
+    {
+        enter_comm_cs();
+        MPI_Testsome(engine.n, engine.reqs, &outcount, indices, MPI_STATUSES_IGNORE);
+        leave_comm_cs();
+    }
+
+    if ((outcount == MPI_UNDEFINED) || (outcount <= 0))
+    {
+        pthread_mutex_unlock(&engine.m);
+        return 0;
+    }
+
+    for (int k = 0; k < outcount; k++)
+    {
+        cbs[k] = engine.cbs[indices[k]];
+        args[k] = engine.args[indices[k]];
+    }
+
+    //! compact the table (completed requests are MPI_REQUEST_NULL)
+    int n = 0;
+    for (int i = 0; i < engine.n; i++)
+    {
+        if (engine.reqs[i] != MPI_REQUEST_NULL)
+        {
+            engine.reqs[n] = engine.reqs[i];
+            engine.cbs[n] = engine.cbs[i];
+            engine.args[n] = engine.args[i];
+            n++;
+        }
+    }
+    engine.n = n;
+
+    pthread_mutex_unlock(&engine.m);
+
+    for (int k = 0; k < outcount; k++)
+    {
+        if (cbs[k] != NULL)
+        {
+            cbs[k](args[k]);
+        }
+    }
+
+    return outcount;
+}
+
+/**
+ * @brief Number of outstanding requests
+ *
+ * @return int
+ */
+int torc_progress_pending()
+{
+    return engine.n;
+}
+
+/**
+ * @brief Completion callback that decrements the counter arg
+ *
+ * @param arg pointer to an int counter
+ */
+void torc_progress_countdown(void *arg)
+{
+    __sync_fetch_and_sub((int *)arg, 1);
+}
+
+/**
+ * @brief Progress until the counter drops to zero
+ * The counter is decremented by the completion callbacks of the caller
+ *
+ * @param counter
+ */
+void torc_progress_wait(volatile int *counter)
+{
+    while (*counter > 0)
+    {
+        if (!torc_progress())
+        {
+            sched_yield();
+        }
+    }
+}
+
+/**
+ * @brief Progress until all the outstanding requests have completed
+ *
+ */
+void torc_progress_drain()
+{
+    while (engine.n > 0)
+    {
+        if (!torc_progress())
+        {
+            sched_yield();
+        }
+    }
+}
+
+/**@}*/
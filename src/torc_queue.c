@@ -15,74 +15,311 @@
  */
 void rq_init()
 {
-    _queue_init(&reuse_q);
+    for (int sc = 0; sc < TORC_DESC_NCLASSES; sc++)
+    {
+        _lock_init(&desc_depot[sc].lock);
+    }
 
     _queue_init(&private_grq);
 
-    for (int i = 0; i < 10; i++)
+    _queue_init(&public_grq);
+
+    for (unsigned int i = 0; i < kthreads; i++)
     {
-        _queue_init(&public_grq[i]);
+        _deque_init(&public_wsq[i]);
+        _queue_init(&public_lrq[i]);
     }
 }
 
 /**
- * @brief Adds the descriptor desc at the tail of the queue reuse_q
- * 
- * @param desc 
+ * @brief Allocate the queues of worker vp on the NUMA node of the calling thread
+ * Called by the pinned worker itself before it takes any work
+ *
+ * @param vp virtual processor ID
  */
-static void torc_to_i_reuseq_end(torc_t *desc)
+void rq_localize(int vp)
 {
-    _enqueue_tail(&reuse_q, desc);
+    _deque_rehome(&public_wsq[vp]);
 }
 
 /**
- * @brief Double-ended queue
- * 
- * @return torc_t* 
+ * @brief Return the virtual processor that owns the deque of the calling thread
+ *
+ * @return int the owner or -1 for threads that are not workers (e.g. the server thread)
  */
-static torc_t *torc_i_reuseq_dequeue()
+static int torc_i_rq_owner()
 {
-    torc_t *desc = NULL;
+    long const vp = _torc_get_vpid();
+
+    return (vp < (long)kthreads) ? (int)vp : -1;
+}
 
-    _dequeue(&reuse_q, &desc);
+/**
+ * @brief Map the level of a descriptor to one of the 10 priority levels
+ *
+ * @param desc
+ * @return int
+ */
+static inline int torc_rq_level(torc_t *desc)
+{
+    int const level = desc->level;
 
-    return desc;
+    return (level <= 1) ? 0 : (level >= 11) ? 9 : level - 1;
+}
+
+/**
+ * \defgroup Descriptor Allocation
+ */
+/**@{*/
+
+//! Cache of the server thread
+#define TORC_DESC_CACHE_SERVER MAX_NVPS
+
+//! Cache shared by all other threads (protected by the depot lock)
+#define TORC_DESC_CACHE_SHARED (MAX_NVPS + 1)
+
+//! Number of argument records of each size class
+static int const torc_desc_nargs[TORC_DESC_NCLASSES] = {2, 4, 8, MAX_TORC_ARGS};
+
+/**
+ * @brief Return the smallest size class that fits narg arguments
+ *
+ * @param narg
+ * @return int
+ */
+static inline int torc_desc_sclass(int narg)
+{
+    int sc = 0;
+    while ((sc < TORC_DESC_NCLASSES - 1) && (torc_desc_nargs[sc] < narg))
+    {
+        sc++;
+    }
+    return sc;
 }
 
-torc_t *_torc_get_reused_desc()
+/**
+ * @brief Size in bytes of the descriptors of size class sc
+ *
+ * @param sc
+ * @return size_t
+ */
+static inline size_t torc_desc_size(int sc)
 {
-    //! Size of the data structure
-    static unsigned long torc_size = sizeof(torc_t);
+    return TORC_DESC_SIZE(torc_desc_nargs[sc]);
+}
 
-    torc_t *desc = torc_i_reuseq_dequeue();
+/**
+ * @brief Size in bytes of the pooled descriptor used for a task with narg arguments
+ *
+ * @param narg
+ * @return size_t
+ */
+size_t _torc_desc_pool_size(int narg)
+{
+    return torc_desc_size(torc_desc_sclass(narg));
+}
 
-    if (desc != NULL)
+/**
+ * @brief Return the descriptor cache of the calling thread
+ *
+ * @param sc size class
+ * @param shared set to 1 if the cache is shared and must be accessed with the depot lock held
+ * @return desc_cache_t*
+ */
+static desc_cache_t *torc_desc_cache(int sc, int *shared)
+{
+    long const vp = _torc_get_vpid();
+
+    *shared = 0;
+
+    if ((vp >= 0) && (vp < (long)kthreads))
+    {
+        return &desc_cache[sc][vp];
+    }
+
+    if (pthread_equal(pthread_self(), server_thread))
+    {
+        return &desc_cache[sc][TORC_DESC_CACHE_SERVER];
+    }
+
+    *shared = 1;
+    return &desc_cache[sc][TORC_DESC_CACHE_SHARED];
+}
+
+/**
+ * @brief Refill an empty cache with a batch from the depot or with a new slab
+ *
+ * @param sc size class
+ * @param cache
+ * @param shared the depot lock is already held
+ */
+static void torc_desc_refill(int sc, desc_cache_t *cache, int shared)
+{
+    desc_depot_t *depot = &desc_depot[sc];
+
+    if (!shared)
     {
-        static unsigned long offset = sizeof(_lock_t);
+        _lock_acquire(&depot->lock);
+    }
 
-        char *ptr = (char *)desc;
-        ptr += offset;
+    torc_t *batch = depot->batches;
+    if (batch != NULL)
+    {
+        depot->batches = batch->prev;
+        batch->prev = NULL;
 
-        memset(ptr, 0, torc_size - offset);
+        cache->c.head = batch;
+        cache->c.count = TORC_DESC_BATCH;
     }
-    else
+
+    if (!shared)
+    {
+        _lock_release(&depot->lock);
+    }
+
+    if (batch != NULL)
+    {
+        return;
+    }
+
+    size_t const size = torc_desc_size(sc);
+
+    //! slabs are never freed, their descriptors circulate between the caches
+    char *slab = (char *)calloc(TORC_DESC_SLAB, size);
+    if (slab == NULL)
+    {
+        Error("Descriptor slab allocation failed!");
+    }
+
+    for (int i = TORC_DESC_SLAB - 1; i >= 0; i--)
+    {
+        torc_t *desc = (torc_t *)(slab + i * size);
+        desc->next = cache->c.head;
+        cache->c.head = desc;
+    }
+    cache->c.count += TORC_DESC_SLAB;
+
+    __sync_fetch_and_add(&depot->nslabs, 1);
+}
+
+/**
+ * @brief Move one batch of descriptors from a full cache to the depot
+ *
+ * @param sc size class
+ * @param cache
+ * @param shared the depot lock is already held
+ */
+static void torc_desc_spill(int sc, desc_cache_t *cache, int shared)
+{
+    desc_depot_t *depot = &desc_depot[sc];
+
+    torc_t *batch = cache->c.head;
+    torc_t *last = batch;
+
+    for (int i = 1; i < TORC_DESC_BATCH; i++)
+    {
+        last = last->next;
+    }
+
+    cache->c.head = last->next;
+    cache->c.count -= TORC_DESC_BATCH;
+    last->next = NULL;
+
+    if (!shared)
+    {
+        _lock_acquire(&depot->lock);
+    }
+
+    batch->prev = depot->batches;
+    depot->batches = batch;
+
+    if (!shared)
+    {
+        _lock_release(&depot->lock);
+    }
+}
+
+/**
+ * @brief Get a free descriptor with room for narg arguments from the cache of the calling thread
+ *
+ * @param narg Number of arguments
+ * @return torc_t* zeroed descriptor
+ */
+torc_t *_torc_get_reused_desc(int narg)
+{
+    int const sc = torc_desc_sclass(narg);
+
+    int shared;
+
+    desc_cache_t *cache = torc_desc_cache(sc, &shared);
+
+    if (shared)
+    {
+        _lock_acquire(&desc_depot[sc].lock);
+    }
+
+    if (cache->c.head == NULL)
+    {
+        torc_desc_refill(sc, cache, shared);
+    }
+
+    torc_t *desc = cache->c.head;
+    cache->c.head = desc->next;
+    cache->c.count--;
+
+    if (shared)
     {
-        desc = calloc(1, torc_size);
+        _lock_release(&desc_depot[sc].lock);
     }
 
+    memset(desc, 0, torc_desc_size(sc));
+
+    desc->sclass = sc;
+
     return desc;
 }
 
 /**
- * @brief Put the descriptor desc at the tail of the queue reuse_q
- * 
- * @param desc 
+ * @brief Return the descriptor desc to the cache of the calling thread
+ * Producer-only threads refill from the batches that consumer-only threads spill
+ *
+ * @param desc
  */
 void _torc_put_reused_desc(torc_t *desc)
 {
-    torc_to_i_reuseq_end(desc);
+    int const sc = desc->sclass;
+
+    if ((sc < 0) || (sc >= TORC_DESC_NCLASSES))
+    {
+        Error1("Invalid descriptor size class %d", sc);
+    }
+
+    int shared;
+
+    desc_cache_t *cache = torc_desc_cache(sc, &shared);
+
+    if (shared)
+    {
+        _lock_acquire(&desc_depot[sc].lock);
+    }
+
+    desc->next = cache->c.head;
+    cache->c.head = desc;
+    cache->c.count++;
+
+    if (cache->c.count >= 2 * TORC_DESC_BATCH)
+    {
+        torc_desc_spill(sc, cache, shared);
+    }
+
+    if (shared)
+    {
+        _lock_release(&desc_depot[sc].lock);
+    }
 }
 
+/**@}*/
+
 /**
  * \defgroup Intra-node Queues
  */
@@ -96,6 +333,7 @@ void _torc_put_reused_desc(torc_t *desc)
 void torc_to_i_pq(torc_t *desc)
 {
     _enqueue_head(&private_grq, desc);
+    _torc_wake_one();
 }
 
 /**
@@ -106,6 +344,7 @@ void torc_to_i_pq(torc_t *desc)
 void torc_to_i_pq_end(torc_t *desc)
 {
     _enqueue_tail(&private_grq, desc);
+    _torc_wake_one();
 }
 
 /**
@@ -123,41 +362,463 @@ torc_t *torc_i_pq_dequeue()
 }
 
 /**
- * @brief Add the descriptor desc at the head of the public global queue public_grq
- * 
- * @param desc 
+ * @brief Add the descriptor desc at the head of the public queues
+ *
+ * A worker pushes at the bottom of its own deque, where it will pick it up next.
+ * Other threads use the shared queue public_grq.
+ *
+ * @param desc
  */
 void torc_to_i_rq(torc_t *desc)
 {
-    int const lvl = (desc->level <= 1) ? 0 : (desc->level >= 11) ? 9 : desc->level - 1;
+    int const me = torc_i_rq_owner();
 
-    _enqueue_head(&public_grq[lvl], desc);
+    if (me >= 0)
+    {
+        _deque_push(&public_wsq[me], desc);
+    }
+    else
+    {
+        _enqueue_head(&public_grq, desc);
+    }
+    _torc_wake_one();
 }
 
 /**
- * @brief Add the descriptor desc at the tail of the public global queue public_grq
- * 
- * @param desc 
+ * @brief Add the descriptor desc at the tail of the public queues
+ *
+ * A worker pushes at the bottom of its own deque, where it will pick it up next.
+ * Other threads use the shared queue public_grq.
+ *
+ * @param desc
  */
 void torc_to_i_rq_end(torc_t *desc)
 {
-    int const lvl = (desc->level <= 1) ? 0 : (desc->level >= 11) ? 9 : desc->level - 1;
+    int const me = torc_i_rq_owner();
 
-    _enqueue_tail(&public_grq[lvl], desc);
+    if (me >= 0)
+    {
+        _deque_push(&public_wsq[me], desc);
+    }
+    else
+    {
+        _enqueue_tail(&public_grq, desc);
+    }
+    _torc_wake_one();
 }
 
 /**
- * @brief Get the descriptor of a double-eneded queue of the public global queue
- * 
- * Based on the way it is called in TORC we do not need to check the lvl bound
- * 
- * @return torc_t* 
+ * @brief Steal a descriptor from the top of the deque of another worker
+ *
+ * The victim is the worker whose oldest descriptor has the preferred level.
+ * Descriptors are never returned to the system, so peeking at a descriptor
+ * that is concurrently stolen and reused is harmless.
+ *
+ * @param me     the calling worker or -1
+ * @param policy TORC_RQ_DEEPEST or TORC_RQ_SHALLOWEST
+ * @return torc_t*
+ */
+static torc_t *torc_i_rq_steal(int me, int policy)
+{
+    int const nvps = kthreads;
+
+    for (int attempt = 0; attempt < 2 * nvps; attempt++)
+    {
+        int victim = -1;
+        int best = 0;
+
+        for (int k = 1; k <= nvps; k++)
+        {
+            int const i = (me + k) % nvps;
+            if (i == me)
+            {
+                continue;
+            }
+
+            torc_t *top = (torc_t *)_deque_peek_top(&public_wsq[i]);
+            if (top == NULL)
+            {
+                continue;
+            }
+
+            int const lvl = torc_rq_level(top);
+            if ((victim < 0) || ((policy == TORC_RQ_DEEPEST) ? (lvl > best) : (lvl < best)))
+            {
+                victim = i;
+                best = lvl;
+            }
+        }
+
+        if (victim < 0)
+        {
+            return NULL;
+        }
+
+        torc_t *desc = (torc_t *)_deque_steal(&public_wsq[victim]);
+        if ((desc != NULL) && (desc != DEQUE_ABORT))
+        {
+            return desc;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Get a descriptor from the public queues
+ *
+ * A worker pops from the bottom of its own deque first (LIFO). Then the shared
+ * queue public_grq is checked and finally a descriptor is stolen from the top
+ * of another deque (FIFO), with the level-based priority used to select the victim.
+ *
+ * @param policy TORC_RQ_DEEPEST (intra-node) or TORC_RQ_SHALLOWEST (inter-node)
+ * @return torc_t*
  */
-torc_t *torc_i_rq_dequeue(int lvl)
+torc_t *torc_i_rq_dequeue(int policy)
 {
+    int const me = torc_i_rq_owner();
+
     torc_t *desc = NULL;
 
-    _dequeue(&public_grq[lvl], &desc);
+    if (me >= 0)
+    {
+        desc = (torc_t *)_deque_pop(&public_wsq[me]);
+        if (desc != NULL)
+        {
+            return desc;
+        }
+    }
+
+    _dequeue(&public_grq, &desc);
+    if (desc != NULL)
+    {
+        return desc;
+    }
+
+    return torc_i_rq_steal(me, policy);
+}
+
+/**
+ * @brief Check (without locking) whether any node-local queue holds a descriptor
+ * Used by an idle worker right before it parks
+ *
+ * @return int 1 if there is work available
+ */
+int torc_i_rq_available()
+{
+    if ((_queue_head(&private_grq) != NULL) || (_queue_head(&public_grq) != NULL))
+    {
+        return 1;
+    }
+
+    for (unsigned int i = 0; i < kthreads; i++)
+    {
+        if ((_deque_size(&public_wsq[i]) > 0) || (_queue_head(&public_lrq[i]) != NULL))
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Count the descriptors of a locked queue, up to max
+ *
+ */
+static long torc_queue_count(queue_t *q, long max)
+{
+    long n = 0;
+
+    _lock_acquire(&q->q.lock);
+    for (torc_t *d = _queue_head(q); (d != NULL) && (n < max); d = d->next)
+    {
+        n++;
+    }
+    _lock_release(&q->q.lock);
+
+    return n;
+}
+
+/**
+ * @brief Estimate the number of descriptors in the public and local ready queues
+ * The deques are read without locking, the queues are walked until max is reached
+ *
+ * @param max counting stops here
+ * @return long
+ */
+long torc_i_rq_size(long max)
+{
+    long n = 0;
+
+    for (unsigned int i = 0; (i < kthreads) && (n < max); i++)
+    {
+        n += _deque_size(&public_wsq[i]);
+    }
+
+    if (n < max)
+    {
+        n += torc_queue_count(&public_grq, max - n);
+    }
+
+    for (unsigned int i = 0; (i < kthreads) && (n < max); i++)
+    {
+        n += torc_queue_count(&public_lrq[i], max - n);
+    }
+
+    return n;
+}
+
+//! Descriptors of a locked queue examined by torc_i_rq_select
+#define TORC_SELECT_SCAN 64
+
+/**
+ * @brief Remove the first of the leading descriptors of a locked queue that accept selects
+ *
+ */
+static torc_t *torc_queue_select(queue_t *q, torc_select_t accept, torc_t *self)
+{
+    if (_queue_head(q) == NULL)
+    {
+        return NULL;
+    }
+
+    torc_t *desc;
+    int n = 0;
+
+    _lock_acquire(&q->q.lock);
+    for (desc = _queue_head(q); (desc != NULL) && (n < TORC_SELECT_SCAN); desc = desc->next, n++)
+    {
+        if (accept(desc, self))
+        {
+            break;
+        }
+    }
+
+    if ((desc != NULL) && (n < TORC_SELECT_SCAN))
+    {
+        if (desc->prev == NULL)
+        {
+            q->q.head = desc->next;
+        }
+        else
+        {
+            desc->prev->next = desc->next;
+        }
+
+        if (desc->next == NULL)
+        {
+            q->q.tail = desc->prev;
+        }
+        else
+        {
+            desc->next->prev = desc->prev;
+        }
+    }
+    else
+    {
+        desc = NULL;
+    }
+    _lock_release(&q->q.lock);
+
+    return desc;
+}
+
+//! Predicate and waiting task of torc_i_rq_select
+typedef struct
+{
+    torc_select_t accept;
+    torc_t *self;
+} torc_selection_t;
+
+/**
+ * @brief Adapter of the predicate of torc_i_rq_select for _deque_steal_if
+ *
+ */
+static int torc_select_top(void *e, void *arg)
+{
+    torc_selection_t *sel = (torc_selection_t *)arg;
+
+    return sel->accept((torc_t *)e, sel->self);
+}
+
+/**
+ * @brief Get a node-local descriptor that accept selects
+ * Used by a waiting task. The private queue, the local queue and the bottom of
+ * the deque of the calling worker are checked first, then the shared queue,
+ * the tops of the other deques and the other local queues
+ *
+ * @param accept selection predicate
+ * @param self   the waiting task, passed to accept
+ * @return torc_t* NULL if no descriptor was selected
+ */
+torc_t *torc_i_rq_select(torc_select_t accept, torc_t *self)
+{
+    int const me = torc_i_rq_owner();
+    int const nvps = kthreads;
+    torc_selection_t sel = {accept, self};
+
+    torc_t *desc = torc_queue_select(&private_grq, accept, self);
+    if (desc != NULL)
+    {
+        return desc;
+    }
+
+    if (me >= 0)
+    {
+        desc = torc_queue_select(&public_lrq[me], accept, self);
+        if (desc != NULL)
+        {
+            return desc;
+        }
+
+        //! a descriptor that is not selected goes back where it was
+        desc = (torc_t *)_deque_pop(&public_wsq[me]);
+        if (desc != NULL)
+        {
+            if (accept(desc, self))
+            {
+                return desc;
+            }
+            _deque_push(&public_wsq[me], desc);
+        }
+    }
+
+    desc = torc_queue_select(&public_grq, accept, self);
+    if (desc != NULL)
+    {
+        return desc;
+    }
+
+    for (int k = 1; k <= nvps; k++)
+    {
+        int const i = (me + k) % nvps;
+        if (i == me)
+        {
+            continue;
+        }
+
+        //! a top that is not selected is left in the deque of its owner
+        do
+        {
+            desc = (torc_t *)_deque_steal_if(&public_wsq[i], torc_select_top, &sel);
+        } while (desc == DEQUE_ABORT);
+
+        if (desc != NULL)
+        {
+            return desc;
+        }
+    }
+
+    for (int k = 1; k <= nvps; k++)
+    {
+        int const i = (me + k) % nvps;
+        if (i == me)
+        {
+            continue;
+        }
+
+        desc = torc_queue_select(&public_lrq[i], accept, self);
+        if (desc != NULL)
+        {
+            return desc;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Add the descriptor desc at the head of the local queue of worker which
+ *
+ * @param which local worker (virtual processor) ID
+ * @param desc
+ */
+void torc_to_i_lrq(int which, torc_t *desc)
+{
+    _enqueue_head(&public_lrq[which], desc);
+    if (!_torc_wake_vp(which))
+    {
+        _torc_wake_one();
+    }
+}
+
+/**
+ * @brief Add the descriptor desc at the tail of the local queue of worker which
+ *
+ * @param which local worker (virtual processor) ID
+ * @param desc
+ */
+void torc_to_i_lrq_end(int which, torc_t *desc)
+{
+    _enqueue_tail(&public_lrq[which], desc);
+    if (!_torc_wake_vp(which))
+    {
+        _torc_wake_one();
+    }
+}
+
+/**
+ * @brief Get the descriptor at the head of the local queue of worker which
+ * This is where the owner of the queue takes its work from
+ *
+ * @param which local worker (virtual processor) ID
+ * @return torc_t*
+ */
+torc_t *torc_i_lrq_dequeue(int which)
+{
+    torc_t *desc = NULL;
+
+    _dequeue(&public_lrq[which], &desc);
+
+    return desc;
+}
+
+/**
+ * @brief Get the descriptor at the tail of the local queue of worker which
+ * This is where the other workers steal from
+ *
+ * @param which local worker (virtual processor) ID
+ * @return torc_t*
+ */
+torc_t *torc_i_lrq_dequeue_end(int which)
+{
+    torc_t *desc = NULL;
+
+    if (_queue_tail(&public_lrq[which]) != NULL)
+    {
+        _dequeue_end(&public_lrq[which], &desc);
+    }
+
+    return desc;
+}
+
+/**
+ * @brief Same as torc_i_lrq_dequeue, for callers that already hold the queue lock
+ *
+ * @param which local worker (virtual processor) ID
+ * @return torc_t*
+ */
+torc_t *torc_i_lrq_dequeue_inner(int which)
+{
+    torc_t *desc = NULL;
+
+    _dequeue_bare(&public_lrq[which], &desc);
+
+    return desc;
+}
+
+/**
+ * @brief Same as torc_i_lrq_dequeue_end, for callers that already hold the queue lock
+ *
+ * @param which local worker (virtual processor) ID
+ * @return torc_t*
+ */
+torc_t *torc_i_lrq_dequeue_end_inner(int which)
+{
+    torc_t *desc = NULL;
+
+    _dequeue_end_bare(&public_lrq[which], &desc);
 
     return desc;
 }
@@ -178,7 +839,7 @@ static void read_arguments(torc_t *desc)
 {
     for (int i = 0; i < desc->narg; i++)
     {
-        desc->temparg[i] = desc->localarg[i];
+        desc->arg[i].temparg = desc->arg[i].localarg;
     }
 }
 
@@ -200,9 +861,7 @@ void torc_to_nrq(int target_node, torc_t *desc)
         printf("enqueing remotely: desc->rte_desc = %p\n", desc);
         fflush(0);
 #endif
-        send_descriptor(target_node, desc, TORC_NORMAL_ENQUEUE);
-
-        _torc_put_reused_desc(desc);
+        post_descriptor(target_node, desc, TORC_NORMAL_ENQUEUE);
     }
     else
     {
@@ -235,9 +894,7 @@ void torc_to_nrq_end(int target_node, torc_t *desc)
         printf("enqueing remotely: desc->rte_desc = %p\n", desc);
         fflush(0);
 #endif
-        send_descriptor(target_node, desc, TORC_NORMAL_ENQUEUE);
-
-        _torc_put_reused_desc(desc);
+        post_descriptor(target_node, desc, TORC_NORMAL_ENQUEUE);
     }
     else
     {
@@ -286,9 +943,7 @@ void torc_to_rq(torc_t *desc)
         printf("enqueing remotely: desc->rte_desc = %p\n", desc);
         fflush(0);
 #endif
-        send_descriptor(target_node, desc, TORC_NORMAL_ENQUEUE);
-
-        _torc_put_reused_desc(desc);
+        post_descriptor(target_node, desc, TORC_NORMAL_ENQUEUE);
     }
     else
     {
@@ -339,9 +994,7 @@ void torc_to_rq_end__(torc_t *desc)
         printf("enqueing remotely: desc->rte_desc = %p\n", desc);
         fflush(0);
 #endif
-        send_descriptor(target_node, desc, TORC_NORMAL_ENQUEUE);
-
-        _torc_put_reused_desc(desc);
+        post_descriptor(target_node, desc, TORC_NORMAL_ENQUEUE);
     }
     else
     {
@@ -386,15 +1039,14 @@ void torc_to_rq_end(torc_t *desc)
     }
 
     int target_node = global_thread_id_to_node_id(target_worker);
-    int target_queue = global_thread_id_to_local_thread_id(target_worker);
 
 #if DEBUG
-    printf("rte_to_rq_end: target_worker = %d, target_node = %d, target_queue = %d\n", target_worker, target_node, target_queue);
+    printf("rte_to_rq_end: target_worker = %d, target_node = %d\n", target_worker, target_node);
     fflush(0);
 #endif
 
-    //! Global
-    desc->target_queue = target_queue;
+    //! Global, the target worker only selects the node
+    desc->target_queue = -1;
     desc->inter_node = 1;
     desc->insert_private = 0;
 
@@ -404,9 +1056,7 @@ void torc_to_rq_end(torc_t *desc)
         printf("enqueing remotely: desc->rte_desc = %p\n", desc);
         fflush(0);
 #endif
-        send_descriptor(target_node, desc, TORC_NORMAL_ENQUEUE);
-
-        _torc_put_reused_desc(desc);
+        post_descriptor(target_node, desc, TORC_NORMAL_ENQUEUE);
     }
     else
     {
@@ -433,13 +1083,6 @@ void torc_to_rq_end(torc_t *desc)
  */
 void torc_to_lrq_end(int target, torc_t *desc)
 {
-    if (torc_num_nodes() == 1)
-    {
-        torc_to_i_rq_end(desc);
-
-        return;
-    }
-
     int target_node = global_thread_id_to_node_id(target);
     int target_queue = global_thread_id_to_local_thread_id(target);
 
@@ -457,9 +1100,7 @@ void torc_to_lrq_end(int target, torc_t *desc)
         printf("enqueing remotely: desc->rte_desc = %p\n", desc);
         fflush(0);
 #endif
-        send_descriptor(target_node, desc, TORC_NORMAL_ENQUEUE);
-
-        _torc_put_reused_desc(desc);
+        post_descriptor(target_node, desc, TORC_NORMAL_ENQUEUE);
     }
     else
     {
@@ -470,19 +1111,12 @@ void torc_to_lrq_end(int target, torc_t *desc)
         //! Read the arguments
         read_arguments(desc);
 
-        torc_to_i_rq_end(desc);
+        torc_to_i_lrq_end(target_queue, desc);
     }
 }
 
 void torc_to_lrq(int target, torc_t *desc)
 {
-    if (torc_num_nodes() == 1)
-    {
-        torc_to_i_rq(desc);
-
-        return;
-    }
-
     int target_node = global_thread_id_to_node_id(target);
     int target_queue = global_thread_id_to_local_thread_id(target);
 
@@ -501,9 +1135,7 @@ void torc_to_lrq(int target, torc_t *desc)
         printf("enqueing remotely: desc->rte_desc = %p\n", desc);
         fflush(0);
 #endif
-        send_descriptor(target_node, desc, TORC_NORMAL_ENQUEUE);
-
-        _torc_put_reused_desc(desc);
+        post_descriptor(target_node, desc, TORC_NORMAL_ENQUEUE);
     }
     else
     {
@@ -514,7 +1146,7 @@ void torc_to_lrq(int target, torc_t *desc)
         //! Read the arguments
         read_arguments(desc);
 
-        torc_to_i_rq(desc);
+        torc_to_i_lrq(target_queue, desc);
     }
 }
 
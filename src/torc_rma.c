@@ -0,0 +1,399 @@
+/*
+ *  torc_rma.c
+ *  TORC_Lite
+ *
+ *  Created by Panagiotis Hadjidoukas on 1/1/14.
+ *  Copyright 2014 ETH Zurich. All rights reserved.
+ *
+ */
+#include <torc_internal.h>
+#include <torc.h>
+
+/**
+ * \defgroup One-sided stealing
+ * With TORC_STEAL_RMA=1 every node exposes a stealing window (MPI-3 RMA):
+ * a fixed number of slots, each holding the message of a ready task with its
+ * arguments. The server thread of the node moves the surplus of its ready
+ * tasks to the free slots and takes them back when the node runs out of work.
+ * A thief reads the states of the slots of a victim, claims full slots with
+ * MPI_Compare_and_swap, pulls their messages with MPI_Get and frees them; the
+ * victim does not take part.
+ *
+ * The state of a slot is TORC_RMA_FREE, TORC_RMA_CLAIMED or the length of
+ * its message. It is only changed with atomic operations: the owner fills a
+ * free slot, a thief claims a full one (compare-and-swap) and frees it once
+ * its message has been copied. The owner claims with a swap, as it is the
+ * only one that fills the slots: a claimed slot stays claimed and a free one
+ * is freed again. A task whose message does not fit in a slot stays with its
+ * node.
+ */
+/**@{*/
+
+//! Slots of the window of a node
+#define TORC_RMA_SLOTS 64
+
+//! Size of a slot in bytes
+#define TORC_RMA_SLOT 8192
+
+//! States of a slot, a full slot holds the length of its message
+#define TORC_RMA_FREE 0
+#define TORC_RMA_CLAIMED (-1)
+
+//! Interval between two visits of the owner to its window (usecs)
+#define TORC_RMA_POLL 50
+
+//! Displacements in the window
+#define TORC_RMA_STATE(i) ((MPI_Aint)(i) * sizeof(INT64))
+#define TORC_RMA_DATA(i) ((MPI_Aint)TORC_RMA_SLOTS * sizeof(INT64) + (MPI_Aint)(i) * TORC_RMA_SLOT)
+
+static struct
+{
+    int enabled;
+    MPI_Win win;
+    //! states, then slots
+    char *base;
+    //! slots filled by this node and not seen free again (server thread only)
+    char published[TORC_RMA_SLOTS];
+    int npublished;
+    double next_poll;
+} rma;
+
+/**
+ * @brief Create the stealing windows, collective over comm_out
+ *
+ */
+void _torc_rma_init()
+{
+    rma.enabled = 0;
+
+    if (torc_num_nodes() == 1)
+    {
+        steal_rma = 0;
+        return;
+    }
+
+    //! all the nodes agree
+    int use = steal_rma;
+
+    enter_comm_cs();
+    MPI_Allreduce(MPI_IN_PLACE, &use, 1, MPI_INT, MPI_MIN, comm_out);
+    leave_comm_cs();
+
+    steal_rma = use;
+    if (!use)
+    {
+        return;
+    }
+
+    MPI_Aint const size = TORC_RMA_DATA(TORC_RMA_SLOTS);
+
+    //! the memory of the window is allocated by MPI, so that it can be registered or shared
+    enter_comm_cs();
+    MPI_Win_allocate(size, 1, MPI_INFO_NULL, comm_out, &rma.base, &rma.win);
+    leave_comm_cs();
+
+    memset(rma.base, 0, size);
+    memset(rma.published, 0, sizeof(rma.published));
+    rma.npublished = 0;
+    rma.next_poll = 0;
+
+    //! the slots are free before anyone reads them
+    enter_comm_cs();
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, rma.win);
+    MPI_Win_sync(rma.win);
+    MPI_Barrier(comm_out);
+    leave_comm_cs();
+
+    rma.enabled = 1;
+
+    if (torc_node_id() == 0)
+    {
+        printf("TORC_LITE ... one-sided stealing: %d slots of %d bytes per node\n", TORC_RMA_SLOTS, TORC_RMA_SLOT);
+        fflush(0);
+    }
+}
+
+/**
+ * @brief Release the stealing windows, collective over comm_out
+ *
+ */
+void _torc_rma_end()
+{
+    if (!rma.enabled)
+    {
+        return;
+    }
+
+    rma.enabled = 0;
+
+    MPI_Win_unlock_all(rma.win);
+    MPI_Win_free(&rma.win);
+    rma.base = NULL;
+}
+
+/**
+ * @brief Read the states of the slots of node atomically
+ * The caller is inside the communication critical section
+ *
+ */
+static void rma_states(int node, INT64 *states)
+{
+    MPI_Get_accumulate(NULL, 0, MPI_LONG_LONG, states, TORC_RMA_SLOTS, MPI_LONG_LONG,
+                       node, 0, TORC_RMA_SLOTS, MPI_LONG_LONG, MPI_NO_OP, rma.win);
+    MPI_Win_flush(node, rma.win);
+}
+
+/**
+ * @brief Claim a full slot of a victim
+ * The caller is inside the communication critical section
+ *
+ * @return int 1 if the slot still held a message of len bytes
+ */
+static int rma_claim(int victim, int slot, INT64 len)
+{
+    INT64 const claimed = TORC_RMA_CLAIMED;
+    INT64 old;
+
+    MPI_Compare_and_swap(&claimed, &len, &old, MPI_LONG_LONG, victim, TORC_RMA_STATE(slot), rma.win);
+    MPI_Win_flush(victim, rma.win);
+
+    return (old == len);
+}
+
+/**
+ * @brief Set the state of a slot of node
+ * The caller is inside the communication critical section
+ *
+ * @return INT64 previous state
+ */
+static INT64 rma_set(int node, int slot, INT64 state)
+{
+    INT64 old;
+
+    MPI_Fetch_and_op(&state, &old, MPI_LONG_LONG, node, TORC_RMA_STATE(slot), MPI_REPLACE, rma.win);
+    MPI_Win_flush(node, rma.win);
+
+    return old;
+}
+
+/**
+ * @brief Enqueue a task taken from a stealing window
+ *
+ * @param desc received descriptor
+ * @param vp   worker that asked for work, or -1
+ */
+static void rma_enqueue(torc_t *desc, int vp)
+{
+    //! homenode == torc_node_id() -> the arguments are still in the owner node
+    if (desc->homenode != torc_node_id())
+    {
+        unpack_arguments(desc);
+    }
+    else
+    {
+        free(desc->payload);
+        desc->payload = NULL;
+    }
+    desc->next = NULL;
+
+    if ((vp >= 0) && (vp < (int)kthreads))
+    {
+        torc_to_i_lrq_end(vp, desc);
+    }
+    else
+    {
+        torc_to_i_rq_end(desc);
+    }
+}
+
+/**
+ * @brief Keep the stealing window of the node filled with its surplus of ready
+ * tasks, and take the tasks back once the node runs out of work (server thread)
+ *
+ */
+void _torc_rma_serve()
+{
+    if (!rma.enabled || appl_finished || termination_flag)
+    {
+        return;
+    }
+
+    double const now = torc_gettime();
+    if (now < rma.next_poll)
+    {
+        return;
+    }
+    rma.next_poll = now + TORC_RMA_POLL * 1.0E-6;
+
+    int const me = torc_node_id();
+    int const idle = !torc_i_rq_available();
+
+    if (rma.npublished > 0)
+    {
+        INT64 states[TORC_RMA_SLOTS];
+
+        enter_comm_cs();
+        rma_states(me, states);
+        leave_comm_cs();
+
+        //! one task back per worker
+        int reclaim = idle ? (int)kthreads : 0;
+
+        for (int i = 0; i < TORC_RMA_SLOTS; i++)
+        {
+            if (!rma.published[i])
+            {
+                continue;
+            }
+
+            INT64 state = states[i];
+
+            if ((reclaim > 0) && (state > 0))
+            {
+                enter_comm_cs();
+                state = rma_set(me, i, TORC_RMA_CLAIMED);
+                if (state == TORC_RMA_FREE)
+                {
+                    rma_set(me, i, TORC_RMA_FREE);
+                }
+                leave_comm_cs();
+
+                if (state > 0)
+                {
+                    torc_t *desc = receive_buffered_descriptor(rma.base + TORC_RMA_DATA(i), state);
+
+                    enter_comm_cs();
+                    rma_set(me, i, TORC_RMA_FREE);
+                    leave_comm_cs();
+
+                    rma.published[i] = 0;
+                    rma.npublished--;
+                    reclaim--;
+
+                    rma_enqueue(desc, -1);
+                    continue;
+                }
+            }
+
+            if (state == TORC_RMA_FREE)
+            {
+                //! stolen
+                rma.published[i] = 0;
+                rma.npublished--;
+                steal_served++;
+            }
+        }
+    }
+
+    if (idle)
+    {
+        return;
+    }
+
+    //! every worker keeps a task, the window holds at most as many as the node
+    long ready = torc_i_rq_size(2 * TORC_RMA_SLOTS);
+
+    for (int i = 0; (i < TORC_RMA_SLOTS) && (ready > (long)kthreads) && (rma.npublished < ready); i++)
+    {
+        if (rma.published[i])
+        {
+            continue;
+        }
+
+        //! as for a stealing request: coarse-grained work first, then work placed on specific workers
+        torc_t *desc = torc_i_rq_dequeue(TORC_RQ_SHALLOWEST);
+        for (unsigned int k = 0; (desc == NULL) && (k < kthreads); k++)
+        {
+            desc = torc_i_lrq_dequeue_end(k);
+        }
+        if (desc == NULL)
+        {
+            break;
+        }
+
+        size_t const len = pack_published(rma.base + TORC_RMA_DATA(i), TORC_RMA_SLOT, desc);
+        if (len == 0)
+        {
+            //! too large for a slot
+            torc_to_i_rq(desc);
+            break;
+        }
+
+        //! the message is written before the slot is seen full
+        enter_comm_cs();
+        MPI_Win_sync(rma.win);
+        rma_set(me, i, (INT64)len);
+        leave_comm_cs();
+
+        rma.published[i] = 1;
+        rma.npublished++;
+        ready--;
+    }
+}
+
+/**
+ * @brief Take tasks from the stealing window of a victim
+ * The first task goes to the local queue of the worker that asked for work,
+ * the rest to the public queues
+ *
+ * @param victim node
+ * @param vp     worker that asks for work, MAX_NVPS for other threads
+ * @return int number of tasks taken
+ */
+int _torc_rma_steal(int victim, int vp)
+{
+    if (!rma.enabled)
+    {
+        return 0;
+    }
+
+    INT64 states[TORC_RMA_SLOTS];
+
+    enter_comm_cs();
+    rma_states(victim, states);
+    leave_comm_cs();
+
+    int full = 0;
+    for (int i = 0; i < TORC_RMA_SLOTS; i++)
+    {
+        full += (states[i] > 0);
+    }
+
+    //! up to half of the published tasks, at most steal_chunk
+    int want = (full + 1) / 2;
+    if (want > steal_chunk)
+    {
+        want = steal_chunk;
+    }
+
+    char buf[TORC_RMA_SLOT];
+    int n = 0;
+
+    for (int i = 0; (i < TORC_RMA_SLOTS) && (n < want); i++)
+    {
+        if (states[i] <= 0)
+        {
+            continue;
+        }
+
+        enter_comm_cs();
+        if (!rma_claim(victim, i, states[i]))
+        {
+            leave_comm_cs();
+            continue;
+        }
+        MPI_Get(buf, (int)states[i], MPI_BYTE, victim, TORC_RMA_DATA(i), (int)states[i], MPI_BYTE, rma.win);
+        MPI_Win_flush(victim, rma.win);
+        rma_set(victim, i, TORC_RMA_FREE);
+        leave_comm_cs();
+
+        torc_t *desc = receive_buffered_descriptor(buf, states[i]);
+
+        rma_enqueue(desc, (n == 0) ? vp : -1);
+        n++;
+    }
+
+    return n;
+}
+
+/**@}*/
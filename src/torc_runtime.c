@@ -58,14 +58,14 @@ void _torc_core_execution(torc_t *desc)
         for (int i = 0; i < desc->narg; i++)
         {
             //! By copy, through pointer to private copy
-            if (desc->callway[i] == CALL_BY_COP)
+            if (desc->arg[i].callway == CALL_BY_COP)
             {
                 //! pointer to the private copy
-                args[i] = (VIRT_ADDR)&desc->localarg[i];
+                args[i] = (VIRT_ADDR)&desc->arg[i].localarg;
             }
             else
             {
-                args[i] = desc->localarg[i];
+                args[i] = desc->arg[i].localarg;
             }
         }
     }
@@ -74,13 +74,13 @@ void _torc_core_execution(torc_t *desc)
         for (int i = 0; i < desc->narg; i++)
         {
             //! By copy, through pointer to private copy
-            if (desc->callway[i] == CALL_BY_COP)
+            if (desc->arg[i].callway == CALL_BY_COP)
             {
-                args[i] = (VIRT_ADDR)&desc->temparg[i];
+                args[i] = (VIRT_ADDR)&desc->arg[i].temparg;
             }
             else
             {
-                args[i] = desc->temparg[i];
+                args[i] = desc->arg[i].temparg;
             }
         }
     }
@@ -126,6 +126,12 @@ void _torc_reset_statistics()
 {
     memset(created, 0, MAX_NVPS * sizeof(unsigned long));
     memset(executed, 0, MAX_NVPS * sizeof(unsigned long));
+    memset(inlined, 0, MAX_NVPS * sizeof(unsigned long));
+    shm_messages = 0;
+
+    steal_requests = 0;
+    steal_latency = 0;
+    steal_latency_max = 0;
 }
 
 /**
@@ -136,12 +142,14 @@ void _torc_print_statistics()
 {
     unsigned long total_created = 0;
     unsigned long total_executed = 0;
+    unsigned long total_inlined = 0;
 
     /* Runtime statistics */
     for (unsigned int i = 0; i < kthreads; i++)
     {
         total_created += created[i];
         total_executed += executed[i];
+        total_inlined += inlined[i];
     }
 
     printf("[%2d] steals served/attempts/hits = %-3ld/%-3ld/%-3ld created = %3ld, executed = %3ld:(", torc_node_id(),
@@ -152,6 +160,22 @@ void _torc_print_statistics()
         printf("%3ld,", executed[i]);
     }
     printf("%3ld)\n", executed[kthreads - 1]);
+
+    if (total_inlined > 0)
+    {
+        printf("[%2d] inlined = %ld of the created tasks\n", torc_node_id(), total_inlined);
+    }
+
+    if (shm_messages > 0)
+    {
+        printf("[%2d] shared-memory messages = %ld\n", torc_node_id(), shm_messages);
+    }
+
+    if (steal_requests > 0)
+    {
+        printf("[%2d] steal requests = %ld, latency avg/max = %.1lf/%.1lf usecs\n", torc_node_id(),
+               steal_requests, steal_latency / steal_requests * 1.0E6, steal_latency_max * 1.0E6);
+    }
     fflush(0);
 }
 
@@ -176,11 +200,41 @@ torc_t *_torc_self()
     return (torc_t *)_torc_get_currt();
 }
 
+/**
+ * @brief The first child of desc accounts for the wait of desc itself
+ *
+ * @param desc TORC descriptor
+ */
+void _torc_depinit(torc_t *desc)
+{
+    int zero = 0;
+    atomic_compare_exchange_strong_explicit(&desc->ndep, &zero, 1, memory_order_relaxed, memory_order_relaxed);
+}
+
+/**
+ * @brief Add ndeps dependencies (children) to desc
+ * Relaxed: a child becomes visible to other threads only through a queue or a message
+ *
+ * @param desc  TORC descriptor
+ * @param ndeps Number of dependencies
+ */
 void _torc_depadd(torc_t *desc, int ndeps)
 {
-    _lock_acquire(&desc->lock);
-    desc->ndep += ndeps;
-    _lock_release(&desc->lock);
+    atomic_fetch_add_explicit(&desc->ndep, ndeps, memory_order_relaxed);
+}
+
+/**
+ * @brief Drop the dependency that the waiting task holds on itself
+ *
+ * @param desc TORC descriptor
+ */
+static void _torc_depleave(torc_t *desc)
+{
+    if (atomic_fetch_sub_explicit(&desc->ndep, 1, memory_order_acq_rel) <= 0)
+    {
+        //! no children were created (torc_waitall without torc_create)
+        atomic_store_explicit(&desc->ndep, 0, memory_order_relaxed);
+    }
 }
 
 /**
@@ -199,10 +253,14 @@ static void _torc_end(void)
     }
 
     appl_finished = 1;
+    _torc_wake_all();
 
     //! notify the rest of the nodes
     if (torc_num_nodes() > 1)
     {
+        torc_aggr_flush(0);
+        torc_progress_drain();
+
         terminate_workers();
     }
 
@@ -224,6 +282,14 @@ void _torc_execute(void *arg)
 
     desc->vp_id = vp;
 
+    //! a task of a cancelled group is dropped without executing
+    if (desc->group_id && _torc_group_cancelled(desc->group_node, desc->group_id))
+    {
+        desc->cancelled = 1;
+        _torc_cleanup(desc);
+        return;
+    }
+
 #ifdef TORC_STATS
     if (desc->rte_type == 1)
     {
@@ -238,32 +304,113 @@ void _torc_execute(void *arg)
     _torc_set_currt(me);
 }
 
-int _torc_block()
+/**
+ * @brief Whether desc is a node-local descendant of the waiting task self
+ * The walk is bounded by the levels between them, so a chain through a
+ * finished and reused ancestor cannot loop
+ *
+ */
+static int torc_wait_descendant(torc_t *desc, torc_t *self)
 {
-    torc_t *desc = _torc_self();
-
-    _lock_acquire(&desc->lock);
-    --desc->ndep;
-    if (desc->ndep < 0)
+    //! the parent of a remote task lives on its home node
+    if (desc->homenode != torc_node_id())
     {
-        desc->ndep = 0;
+        return 0;
     }
-    _lock_release(&desc->lock);
 
-    while (1)
+    torc_t *p = desc->parent;
+    for (int k = desc->level - self->level; (k > 0) && (p != NULL); k--, p = p->parent)
     {
-        _lock_acquire(&desc->lock);
-        if (desc->ndep <= 0)
+        if (p == self)
         {
-            _lock_release(&desc->lock);
             return 1;
         }
-        _lock_release(&desc->lock);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Whether desc is deep enough below the waiting task self to be run meanwhile
+ * Deeper tasks are expected to be finer grained
+ *
+ */
+static int torc_wait_bounded(torc_t *desc, torc_t *self)
+{
+    return desc->level >= self->level + wait_levels;
+}
+
+/**
+ * @brief Wait for the children of self, running its descendants first (help-first)
+ * Other tasks are run only if they are wait_levels deeper than self, and any
+ * task once no descendant has been found for wait_usecs
+ *
+ * @param self the waiting task
+ */
+static void _torc_block_descendants(torc_t *self)
+{
+    int const vp = _torc_get_vpid();
+
+    double since = torc_gettime();
+
+    while (atomic_load_explicit(&self->ndep, memory_order_acquire) > 0)
+    {
+        torc_t *next = torc_i_rq_select(torc_wait_descendant, self);
+
+        if ((next == NULL) && (wait_levels >= 0))
+        {
+            next = torc_i_rq_select(torc_wait_bounded, self);
+        }
+
+        if (next != NULL)
+        {
+            _torc_idle_reset(vp);
+            _torc_execute(next);
+            since = torc_gettime();
+            continue;
+        }
+
+        if ((wait_usecs >= 0) && ((torc_gettime() - since) * 1.0E6 >= wait_usecs))
+        {
+            //! the bound has expired: any task, including work stolen from other nodes
+            _torc_scheduler_loop(1);
+            continue;
+        }
+
+        //! complete outstanding sends and batches, then spin, yield and park until woken up
+        if (torc_progress_pending())
+        {
+            torc_progress();
+        }
+        torc_aggr_flush(1);
 
+        _torc_idle(vp);
+    }
+}
+
+int _torc_block()
+{
+    torc_t *desc = _torc_self();
+
+    //! the children may be waiting in the batches of remote enqueues
+    torc_aggr_flush(0);
+
+    _torc_depleave(desc);
+
+    if (wait_policy == TORC_WAIT_DESCENDANTS)
+    {
+        _torc_block_descendants(desc);
+
+        return 1;
+    }
+
+    //! acquire: the results of the children are visible once ndep drops to zero
+    while (atomic_load_explicit(&desc->ndep, memory_order_acquire) > 0)
+    {
         _torc_scheduler_loop(1);
     }
 
-    return 0;
+    return 1;
 }
 
 /* Q: What did I do here? - A: Block until no more work exists at the cluster-layer. Useful for SPMD-like barriers */
@@ -271,30 +418,15 @@ int _torc_block2()
 {
     torc_t *desc = _torc_self();
 
-    _lock_acquire(&desc->lock);
-    --desc->ndep;
-    if (desc->ndep < 0)
-    {
-        desc->ndep = 0;
-    }
-    _lock_release(&desc->lock);
+    //! the children may be waiting in the batches of remote enqueues
+    torc_aggr_flush(0);
+
+    _torc_depleave(desc);
 
     while (1)
     {
-        if (desc->ndep > 0)
-        {
-            _lock_acquire(&desc->lock);
-            if (desc->ndep <= 0)
-            {
-                desc->ndep = 0;
-                _lock_release(&desc->lock);
-                return 1;
-            }
-            _lock_release(&desc->lock);
-        }
-
         int work = _torc_scheduler_loop(1);
-        if ((desc->ndep == 0) && (!work))
+        if ((atomic_load_explicit(&desc->ndep, memory_order_acquire) <= 0) && (!work))
         {
             return 0;
         }
@@ -323,15 +455,57 @@ void _torc_set_work_routine(torc_t *desc, void (*work)())
 
 int _torc_depsatisfy(torc_t *desc)
 {
-    int deps;
+    return _torc_depsatisfy_n(desc, 1);
+}
+
+/**
+ * @brief Satisfy n dependencies of desc at once (e.g. the answers of a batch)
+ *
+ * @param desc TORC descriptor
+ * @param n    Number of satisfied dependencies
+ * @return int 1 if desc has no more dependencies
+ */
+int _torc_depsatisfy_n(torc_t *desc, int n)
+{
+    //! release: the results written for desc become visible to its owner
+    int const deps = atomic_fetch_sub_explicit(&desc->ndep, n, memory_order_acq_rel) - n;
 
-    _lock_acquire(&desc->lock);
-    deps = --desc->ndep;
-    _lock_release(&desc->lock);
+    //! the owner may be parked in _torc_block
+    if (deps == 0)
+    {
+        _torc_wake_vp(desc->vp_id);
+    }
 
     return !deps;
 }
 
+/**
+ * @brief Mark the future of a finished task, its results are already in place
+ *
+ * @param future completion record
+ */
+void _torc_future_complete(torc_future_t *future)
+{
+    if (future->tracked)
+    {
+        //! release the tasks that wait for this one
+        _torc_dataflow_complete(future);
+
+        if (!future->handle)
+        {
+            free(future);
+            return;
+        }
+    }
+
+    //! the waiter may release the future as soon as done is set
+    long const vp = future->vp_id;
+
+    atomic_store_explicit(&future->done, 1, memory_order_release);
+
+    _torc_wake_vp(vp);
+}
+
 /**
  * @brief Initializes the TORC execution environment on the comm_in communicator
  * This is the new interface which would take the communicator
@@ -404,6 +578,97 @@ void __torc_opt(int argc, char *argv[], MPI_Comm comm_in)
         {
             throttling_factor = val;
         }
+
+        cutoff_level = -1;
+        s = (char *)getenv("TORC_CUTOFF_LEVEL");
+        if (s != 0 && sscanf(s, "%d", &val) == 1 && val >= 0)
+        {
+            cutoff_level = val;
+        }
+
+        affinity = TORC_AFFINITY_NONE;
+        s = (char *)getenv("TORC_AFFINITY");
+        if (s != 0 && _torc_affinity_policy(s) >= 0)
+        {
+            affinity = _torc_affinity_policy(s);
+        }
+
+        wait_policy = TORC_DEF_WAIT_POLICY;
+        s = (char *)getenv("TORC_WAIT_POLICY");
+        if (s != 0)
+        {
+            if ((strcmp(s, "descendants") == 0) || (sscanf(s, "%d", &val) == 1 && val == TORC_WAIT_DESCENDANTS))
+            {
+                wait_policy = TORC_WAIT_DESCENDANTS;
+            }
+            else if ((strcmp(s, "any") == 0) || (sscanf(s, "%d", &val) == 1 && val == TORC_WAIT_ANY))
+            {
+                wait_policy = TORC_WAIT_ANY;
+            }
+        }
+
+        wait_usecs = TORC_DEF_WAIT_USECS;
+        s = (char *)getenv("TORC_WAIT_USECS");
+        if (s != 0 && sscanf(s, "%d", &val) == 1)
+        {
+            wait_usecs = (val >= 0) ? val : -1;
+        }
+
+        wait_levels = TORC_DEF_WAIT_LEVELS;
+        s = (char *)getenv("TORC_WAIT_LEVELS");
+        if (s != 0 && sscanf(s, "%d", &val) == 1)
+        {
+            wait_levels = (val >= 0) ? val : -1;
+        }
+
+        aggr_bytes = TORC_DEF_AGGR_BYTES;
+        s = (char *)getenv("TORC_AGGR_BYTES");
+        if (s != 0 && sscanf(s, "%d", &val) == 1 && val >= 0)
+        {
+            aggr_bytes = val;
+        }
+
+        aggr_usecs = TORC_DEF_AGGR_USECS;
+        s = (char *)getenv("TORC_AGGR_USECS");
+        if (s != 0 && sscanf(s, "%d", &val) == 1 && val >= 0)
+        {
+            aggr_usecs = val;
+        }
+
+        steal_policy = TORC_DEF_STEAL_POLICY;
+        s = (char *)getenv("TORC_STEAL_POLICY");
+        if (s != 0 && _torc_steal_policy(s) >= 0)
+        {
+            steal_policy = _torc_steal_policy(s);
+        }
+
+        steal_chunk = TORC_DEF_STEAL_CHUNK;
+        s = (char *)getenv("TORC_STEAL_CHUNK");
+        if (s != 0 && sscanf(s, "%d", &val) == 1 && val > 0)
+        {
+            steal_chunk = (val < TORC_STEAL_CHUNK_MAX) ? val : TORC_STEAL_CHUNK_MAX;
+        }
+
+        steal_window = TORC_DEF_STEAL_WINDOW;
+        s = (char *)getenv("TORC_STEAL_WINDOW");
+        if (s != 0 && sscanf(s, "%d", &val) == 1 && val > 0)
+        {
+            steal_window = val;
+        }
+
+        steal_rma = TORC_DEF_STEAL_RMA;
+        s = (char *)getenv("TORC_STEAL_RMA");
+        if (s != 0 && sscanf(s, "%d", &val) == 1 && val >= 0)
+        {
+            steal_rma = (val > 0);
+        }
+
+        internode_stealing = TORC_DEF_STEALING;
+        s = (char *)getenv("TORC_STEALING");
+        if (s != 0 && sscanf(s, "%d", &val) == 1 && val >= 0)
+        {
+            internode_stealing = (val > 0);
+        }
     }
 
     MPI_Comm_rank(comm_in, &mpi_rank);
@@ -465,42 +730,30 @@ torc_t *get_next_task()
     //! Get a pointer to the double-eneded private global queue
     torc_t *desc_next = torc_i_pq_dequeue();
 
+    int const me = _torc_get_vpid();
+
+    //! Work placed on this worker comes first
+    if ((desc_next == NULL) && (me >= 0))
+    {
+        desc_next = torc_i_lrq_dequeue(me);
+    }
+
     //! If the descriptor is not assigned
     if (desc_next == NULL)
     {
-        for (int i = 9; i >= 0; i--)
+        //! Own deque first, then steal from the other workers (deepest level first)
+        desc_next = torc_i_rq_dequeue(TORC_RQ_DEEPEST);
+
+        //! Steal from the local queues of the other workers
+        for (unsigned int k = 1; (desc_next == NULL) && (k < kthreads); k++)
         {
-            //! Get a pointer to the descriptor of a public global double-eneded queue with ID i
-            desc_next = torc_i_rq_dequeue(i);
-            if (desc_next != NULL)
-            {
-                break;
-            }
+            desc_next = torc_i_lrq_dequeue_end((me + k) % kthreads);
         }
 
-        if (internode_stealing)
+        //! ask the other nodes for work, the stolen tasks are delivered to this worker
+        if (internode_stealing && (desc_next == NULL))
         {
-            int const self_node = torc_node_id();
-            int const nnodes = torc_num_nodes();
-            int node = (self_node + 1) % nnodes;
-
-            if (desc_next == NULL)
-            {
-                while (node != self_node)
-                {
-                    desc_next = direct_synchronous_stealing_request(node);
-                    if (desc_next != NULL)
-                    {
-                        break;
-                    }
-                    node = (node + 1) % nnodes;
-                }
-            }
-
-            if (desc_next == NULL)
-            {
-                internode_stealing = 0;
-            }
+            _torc_steal();
         }
     }
 
@@ -530,7 +783,10 @@ void _torc_cleanup(torc_t *desc)
         printf("[%d] sending an answer to %d\n", torc_node_id(), desc->homenode);
         fflush(0);
 #endif
-        send_descriptor(desc->homenode, desc, TORC_ANSWER);
+        //! the progress engine returns desc to the pool once the answer is sent
+        post_descriptor(desc->homenode, desc, TORC_ANSWER);
+
+        return;
     }
     else
     {
@@ -541,15 +797,25 @@ void _torc_cleanup(torc_t *desc)
 
         for (int i = 0; i < desc->narg; i++)
         {
-            if ((desc->callway[i] == CALL_BY_COP2) && (desc->quantity[i] > 1))
+            if ((desc->arg[i].callway == CALL_BY_COP2) && (desc->arg[i].quantity > 1))
             {
-                if ((void *)desc->localarg[i] != NULL)
+                if ((void *)desc->arg[i].localarg != NULL)
                 {
-                    free((void *)desc->localarg[i]);
+                    free((void *)desc->arg[i].localarg);
                 }
             }
         }
 
+        if (desc->future)
+        {
+            _torc_future_complete(desc->future);
+        }
+
+        if (desc->group_id)
+        {
+            _torc_group_done(desc);
+        }
+
         if (desc->parent)
         {
             _torc_depsatisfy(desc->parent);
@@ -575,19 +841,25 @@ int _torc_scheduler_loop(int once)
                 _torc_md_end();
             }
 
-            thread_sleep(yieldtime);
+            //! complete outstanding sends and batches, if any
+            if (torc_progress_pending())
+            {
+                torc_progress();
+            }
+            torc_aggr_flush(1);
+
+            //! spin, yield and finally park until new work is enqueued
+            _torc_idle(_torc_get_vpid());
 
             desc_next = get_next_task();
-            if (desc_next == NULL)
+            if ((desc_next == NULL) && once)
             {
-                if (once)
-                {
-                    return 0;
-                }
-                thread_sleep(yieldtime);
+                return 0;
             }
         }
 
+        _torc_idle_reset(_torc_get_vpid());
+
         /* Execute selected task */
         _torc_execute(desc_next);
 
@@ -9,22 +9,65 @@
 #include <torc_internal.h>
 #include <torc.h>
 
-static torc_t no_work_desc;
-
 //! Server thread mutex object
 static pthread_mutex_t server_thread_m = PTHREAD_MUTEX_INITIALIZER;
 
-//! Internode mutex
-static pthread_mutex_t internode_m = PTHREAD_MUTEX_INITIALIZER;
-
 //! Voletile flag to indicate the termination
 volatile int termination_flag = 0;
 
 //! Indicator if the server is still alive
 static int server_thread_alive = 0;
 
-//! Size of the data structure
-static unsigned long const torc_size = sizeof(torc_t);
+//! Empty polls of the server thread before it starts napping
+#define TORC_SERVER_SPINS 1000
+
+//! Nap of an idle server thread (usecs)
+#define TORC_SERVER_NAP 50
+
+/**
+ * @brief Copy the results of an answer and release its local copies
+ *
+ * @param desc answer
+ * @return torc_t* the descriptor whose dependency is satisfied (may be NULL)
+ */
+static torc_t *accept_answer(torc_t *desc)
+{
+    //! copy the results, if any (a dropped task has none)
+    if (!desc->cancelled)
+    {
+        unpack_results(desc);
+    }
+    else
+    {
+        free(desc->payload);
+        desc->payload = NULL;
+    }
+
+    for (int i = 0; i < desc->narg; i++)
+    {
+        if ((desc->arg[i].quantity > 0) && (desc->arg[i].callway == CALL_BY_COP2))
+        {
+            free((void *)desc->arg[i].localarg);
+
+            desc->arg[i].localarg = 0;
+        }
+    }
+
+    if (desc->future)
+    {
+        _torc_future_complete(desc->future);
+    }
+
+    if (desc->group_id)
+    {
+        _torc_group_done(desc);
+    }
+
+    return desc->parent;
+}
+
+//! Distinct parents whose dependencies are decremented together
+#define TORC_BATCH_PARENTS 16
 
 /**
  * @brief Accept received descriptor from a process of desc->sourcenode
@@ -41,8 +84,6 @@ int process_a_received_descriptor(torc_t *desc)
     }
 #endif
 
-    MPI_Request request;
-
     desc->next = NULL;
 
     int tag = desc->sourcevpid;
@@ -64,38 +105,10 @@ int process_a_received_descriptor(torc_t *desc)
         printf("Server %d accepted from %d, narg = %d [ANSWER]\n", torc_node_id(), desc->sourcenode, desc->narg);
         fflush(stdout);
 #endif
-        //! receive the results, if any
-        for (int i = 0; i < desc->narg; i++)
+        torc_t *parent = accept_answer(desc);
+        if (parent)
         {
-            if (desc->quantity[i] == 0)
-            {
-                continue;
-            }
-
-            if ((desc->callway[i] == CALL_BY_RES) || (desc->callway[i] == CALL_BY_REF))
-            {
-                enter_comm_cs();
-                desc->dtype[i] = _torc_b2mpi_type(desc->btype[i]);
-                MPI_Irecv((void *)desc->localarg[i], desc->quantity[i], desc->dtype[i], desc->sourcenode, tag, comm_out, &request);
-                MPI_Wait(&request, MPI_STATUS_IGNORE);
-                leave_comm_cs();
-            }
-            else if (desc->callway[i] == CALL_BY_COP2)
-            {
-                free((void *)desc->localarg[i]);
-
-                desc->localarg[i] = 0;
-            }
-
-#if DEBUG
-            printf("received data from %d\n", desc->sourcenode);
-            fflush(0);
-#endif
-        }
-
-        if (desc->parent)
-        {
-            _torc_depsatisfy(desc->parent);
+            _torc_depsatisfy(parent);
         }
 
         return 1;
@@ -117,14 +130,14 @@ int process_a_received_descriptor(torc_t *desc)
             printf("Server %d accepted from %d, narg = %d [WORK]\n", torc_node_id(), desc->sourcenode, desc->narg);
             fflush(stdout);
 #endif
-            receive_arguments(desc, tag);
+            unpack_arguments(desc);
 
             //! direct execution
             if (desc->rte_type == 20)
             {
                 _torc_core_execution(desc);
 
-                send_descriptor(desc->homenode, desc, TORC_ANSWER);
+                post_descriptor(desc->homenode, desc, TORC_ANSWER);
 
                 return 0;
             }
@@ -145,7 +158,18 @@ int process_a_received_descriptor(torc_t *desc)
                     torc_to_i_pq_end(desc);
                 }
             }
-            //! 0: public queues
+            //! 0: public queues - local queue of the target worker, if any
+            else if ((desc->target_queue >= 0) && (desc->target_queue < (int)kthreads))
+            {
+                if (desc->insert_in_front)
+                {
+                    torc_to_i_lrq(desc->target_queue, desc);
+                }
+                else
+                {
+                    torc_to_i_lrq_end(desc->target_queue, desc);
+                }
+            }
             else
             {
                 if (desc->insert_in_front)
@@ -163,37 +187,131 @@ int process_a_received_descriptor(torc_t *desc)
     }
     break;
 
-    case DIRECT_SYNCHRONOUS_STEALING_REQUEST:
+    case TORC_BATCH:
     {
 #if DEBUG
-        printf("Server %d received request for synchronous stealing\n", torc_node_id());
-        fflush(0);
+        printf("Server %d accepted from %d, %lld descriptors [BATCH]\n", torc_node_id(), desc->sourcenode, desc->arg[0].temparg);
+        fflush(stdout);
 #endif
-        steal_attempts++;
+        //! the descriptors of the batch are processed as if they had been received one by one,
+        //! except that the answers to the same parent satisfy its dependencies at once
+        torc_t *parents[TORC_BATCH_PARENTS];
+        int ndeps[TORC_BATCH_PARENTS];
+        int nparents = 0;
 
-        torc_t *stolen_work = NULL;
+        char *cursor = NULL;
 
-        for (int i = 0; i < 10; i++)
+        torc_t *entry;
+        while ((entry = unpack_batch(desc, &cursor)) != NULL)
         {
-            stolen_work = torc_i_rq_dequeue(i);
-            if (stolen_work != NULL)
+            if (entry->type != TORC_ANSWER)
             {
-                break;
+                if (process_a_received_descriptor(entry))
+                {
+                    _torc_put_reused_desc(entry);
+                }
+                continue;
+            }
+
+            torc_t *parent = accept_answer(entry);
+            _torc_put_reused_desc(entry);
+
+            if (parent == NULL)
+            {
+                continue;
             }
+
+            int k = 0;
+            while ((k < nparents) && (parents[k] != parent))
+            {
+                k++;
+            }
+
+            if (k == nparents)
+            {
+                if (nparents == TORC_BATCH_PARENTS)
+                {
+                    _torc_depsatisfy_n(parents[0], ndeps[0]);
+
+                    nparents--;
+                    memmove(&parents[0], &parents[1], nparents * sizeof(parents[0]));
+                    memmove(&ndeps[0], &ndeps[1], nparents * sizeof(ndeps[0]));
+                    k = nparents;
+                }
+                parents[k] = parent;
+                ndeps[k] = 0;
+                nparents++;
+            }
+            ndeps[k]++;
         }
 
-        if (stolen_work != NULL)
+        for (int k = 0; k < nparents; k++)
         {
-            direct_send_descriptor(DIRECT_SYNCHRONOUS_STEALING_REQUEST, desc->sourcenode, desc->sourcevpid, stolen_work);
+            _torc_depsatisfy_n(parents[k], ndeps[k]);
+        }
+
+        free(desc->payload);
+        desc->payload = NULL;
 
-            steal_served++;
+        return 1;
+    }
+    break;
+
+    case TORC_STEAL_REQUEST:
+    {
+#if DEBUG
+        printf("Server %d received a stealing request from %d\n", torc_node_id(), desc->sourcenode);
+        fflush(0);
+#endif
+        steal_attempts++;
+
+        //! up to half of the ready tasks, at most steal_chunk
+        long want = (torc_i_rq_size(2 * steal_chunk) + 1) / 2;
+        if (want < 1)
+        {
+            want = 1;
         }
-        else
+        if (want > steal_chunk)
         {
-            direct_send_descriptor(DIRECT_SYNCHRONOUS_STEALING_REQUEST, desc->sourcenode, desc->sourcevpid, &no_work_desc);
+            want = steal_chunk;
+        }
+
+        torc_t *stolen_work[TORC_STEAL_CHUNK_MAX];
+        int nstolen = 0;
+
+        while (nstolen < want)
+        {
+            //! Coarse-grained (shallowest level) work first
+            torc_t *work = torc_i_rq_dequeue(TORC_RQ_SHALLOWEST);
+
+            //! Then work placed on specific workers
+            for (unsigned int i = 0; (work == NULL) && (i < kthreads); i++)
+            {
+                work = torc_i_lrq_dequeue_end(i);
+            }
+
+            if (work == NULL)
+            {
+                break;
+            }
+
+            stolen_work[nstolen++] = work;
         }
 
-        return 0;
+        //! the thief answers to the owner node, the local copies are released once sent
+        post_steal_reply(desc->sourcenode, desc->arg[1].localarg, stolen_work, nstolen);
+
+        steal_served += nstolen;
+
+        return 1;
+    }
+    break;
+
+    case TORC_STEAL_REPLY:
+    {
+        _torc_steal_reply(desc);
+
+        return 1;
     }
     break;
 
@@ -208,9 +326,10 @@ int process_a_received_descriptor(torc_t *desc)
     {
         termination_flag = 1;
 
-        if (desc->localarg[0] != torc_node_id())
+        if (desc->arg[0].localarg != torc_node_id())
         {
             appl_finished++;
+            _torc_wake_all();
         }
 
 #if DEBUG
@@ -222,47 +341,44 @@ int process_a_received_descriptor(torc_t *desc)
     }
     break;
 
-    case ENABLE_INTERNODE_STEALING:
+    case TORC_GROUP_CANCEL:
     {
-        internode_stealing = 1;
+        _torc_group_mark_cancelled((int)desc->arg[0].localarg, (int)desc->arg[1].localarg);
 
         return 1;
     }
     break;
 
-    case DISABLE_INTERNODE_STEALING:
+    case RESET_STATISTICS:
     {
-        internode_stealing = 0;
+        torc_reset_statistics();
 
         return 1;
     }
     break;
 
-    case RESET_STATISTICS:
+    case TORC_BCAST:
     {
-        torc_reset_statistics();
+        //! the segments are received and forwarded by the progress engine
+        _torc_bcast_relay(desc);
 
         return 1;
     }
     break;
 
-    case TORC_BCAST:
+    case TORC_BCAST_DONE:
     {
-        void *buffer = (void *)desc->localarg[1];
-
-        int count = desc->localarg[2];
+        _torc_bcast_done(desc);
 
-        MPI_Datatype dtype = _torc_b2mpi_type(desc->localarg[3]);
-
-#if DEBUG
-        printf("TORC_BCAST: %p %d\n", buffer, count);
-        fflush(0);
-#endif
+        return 1;
+    }
+    break;
 
-        enter_comm_cs();
-        MPI_Irecv((void *)buffer, count, dtype, desc->sourcenode, tag, comm_out, &request);
-        MPI_Wait(&request, MPI_STATUS_IGNORE);
-        leave_comm_cs();
+    case TORC_REDUCE:
+    case TORC_GATHER:
+    {
+        //! the results of the children are received and sent up by the progress engine
+        _torc_gather_relay(desc, desc->type);
 
         return 1;
     }
@@ -289,75 +405,74 @@ void *server_loop(void *arg)
     fflush(stdout);
 #endif
 
-    memset(&no_work_desc, 0, torc_size);
-
-    no_work_desc.type = TORC_NO_WORK;
-
-    MPI_Request request;
-    int reuse = 0;
-
-    torc_t *desc = NULL;
+    MPI_Status status;
 
     while (1)
     {
-        if (!reuse)
-        {
-            desc = _torc_get_reused_desc();
-        }
-
-        memset(desc, 0, torc_size);
-
 #if DEBUG
         printf("Server %d waits for a descriptor ....\n", torc_node_id());
         fflush(0);
 #endif
 
-        if (thread_safe)
-        {
-            MPI_Irecv(desc, torc_size, MPI_CHAR, MPI_ANY_SOURCE, MAX_NVPS, comm_out, &request);
-            MPI_Wait(&request, MPI_STATUS_IGNORE);
-        }
-        else
+        //! the size of the descriptor is known after probing
+        //! while waiting, the server thread drives the progress engine
+        torc_t *desc = NULL;
+        int idle = 0;
+        while (1)
         {
-            if (termination_flag >= 1)
+            if (!thread_safe && (termination_flag >= 1))
             {
+                printf("server threads exits!\n");
+                fflush(0);
                 pthread_exit(0);
             }
 
+            //! the nodes of the same host write to the ring of this node
+            desc = torc_shm_receive();
+            if (desc != NULL)
+            {
+                break;
+            }
+
+            int flag = 0;
+
             enter_comm_cs();
-            MPI_Irecv(desc, torc_size, MPI_CHAR, MPI_ANY_SOURCE, MAX_NVPS, comm_out, &request);
+            MPI_Iprobe(MPI_ANY_SOURCE, MAX_NVPS, comm_out, &flag, &status);
             leave_comm_cs();
 
-            int flag = 0;
-            while (1)
+            if (flag == 1)
             {
-                if (termination_flag >= 1)
-                {
-                    printf("server threads exits!\n");
-                    fflush(0);
-                    pthread_exit(0);
-                }
+                desc = receive_probed_descriptor(&status, MAX_NVPS);
+                break;
+            }
 
-                enter_comm_cs();
-                MPI_Test(&request, &flag, MPI_STATUS_IGNORE);
-                leave_comm_cs();
+            //! the server thread bounds the delay of the batches of remote enqueues
+            torc_aggr_flush(1);
 
-                if (flag == 1)
-                {
-                    break;
-                }
-                else
-                {
-                    thread_sleep(yieldtime);
-                }
+            //! the surplus of ready tasks goes to the stealing window of the node
+            _torc_rma_serve();
+
+            if (torc_progress() > 0)
+            {
+                idle = 0;
+            }
+            else if (++idle < TORC_SERVER_SPINS)
+            {
+                sched_yield();
+            }
+            else
+            {
+                usleep(TORC_SERVER_NAP);
             }
         }
 
-        reuse = process_a_received_descriptor(desc);
+        //! every message tells whether its sender has work to give
+        _torc_steal_hint(desc->sourcenode, desc->work_hint);
+
+        int const reuse = process_a_received_descriptor(desc);
         if (reuse)
         {
             _torc_put_reused_desc(desc);
-            reuse = 0;
         }
     }
 
@@ -375,6 +490,7 @@ void start_server_thread()
 
     pthread_attr_init(&attr);
     pthread_attr_setscope(&attr, PTHREAD_SCOPE_SYSTEM);
+    _torc_affinity_attr(&attr, MAX_NVPS);
 
     {
         pthread_mutex_lock(&server_thread_m);
@@ -400,7 +516,9 @@ void start_server_thread()
 
 void shutdown_server_thread()
 {
-    static torc_t mydata;
+    static torc_ctl_t ctl;
+
+    torc_t *mydata = &ctl.desc;
 
 #if DEBUG
     printf("[%d]: Terminating local server thread....\n", torc_node_id());
@@ -416,11 +534,11 @@ void shutdown_server_thread()
             return;
         }
 
-        memset(&mydata, 0, sizeof(mydata));
+        memset(&ctl, 0, sizeof(ctl));
 
         if (thread_safe)
         {
-            send_descriptor(torc_node_id(), &mydata, TERMINATE_LOCAL_SERVER_THREAD);
+            send_descriptor(torc_node_id(), mydata, TERMINATE_LOCAL_SERVER_THREAD);
         }
         else
         {
@@ -442,74 +560,31 @@ void terminate_workers()
     printf("Terminating worker threads ...\n");
 #endif
 
-    torc_t mydata;
-    memset(&mydata, 0, torc_size);
+    torc_ctl_t ctl;
+    memset(&ctl, 0, sizeof(ctl));
+
+    torc_t *mydata = &ctl.desc;
 
     int const mynode = torc_node_id();
 
-    mydata.localarg[0] = mynode;
-    mydata.homenode = mynode;
+    mydata->narg = 1;
+    mydata->arg[0].localarg = mynode;
+    mydata->homenode = mynode;
 
     for (int node = 0; node < torc_num_nodes(); node++)
     {
         if (node != mynode)
         {
-            send_descriptor(node, &mydata, TERMINATE_WORKER_THREADS);
+            send_descriptor(node, mydata, TERMINATE_WORKER_THREADS);
         }
     }
 }
 
-/**********************     INTERNODE STEALING      **********************/
-torc_t *direct_synchronous_stealing_request(int target_node)
-{
-    if (termination_flag)
-    {
-        return NULL;
-    }
-
-    torc_t *desc = NULL;
-
-    {
-        int vp = target_node;
-
-        pthread_mutex_lock(&internode_m);
-
-        desc = _torc_get_reused_desc();
-
-#if DEBUG
-        printf("[%d] Synchronous stealing request ...\n", torc_node_id());
-        fflush(0);
-#endif
-
-        torc_t mydata;
-        memset(&mydata, 0, sizeof(mydata));
-
-        mydata.localarg[0] = torc_node_id();
-        mydata.homenode = torc_node_id();
-
-        send_descriptor(vp, &mydata, DIRECT_SYNCHRONOUS_STEALING_REQUEST);
-
-        receive_descriptor(vp, desc);
-
-        desc->next = NULL;
-
-        pthread_mutex_unlock(&internode_m);
-    }
-
-    if (desc->type == TORC_NO_WORK)
-    {
-        usleep(100 * 1000);
-
-        _torc_put_reused_desc(desc);
-
-        return NULL;
-    }
-
-    steal_hits++;
-
-    return desc;
-}
-
+/**
+ * @brief Disable inter-node stealing on the calling node
+ * Stealing throttles itself (torc_steal.c), so the call no longer has to
+ * reach the other nodes
+ */
 void torc_disable_stealing()
 {
 #if DEBUG
@@ -518,26 +593,12 @@ void torc_disable_stealing()
 #endif
 
     internode_stealing = 0;
-
-    torc_t mydata;
-    memset(&mydata, 0, torc_size);
-
-    int const mynode = torc_node_id();
-
-    mydata.localarg[0] = (INT64)mynode;
-    mydata.homenode = mynode;
-    mydata.sourcenode = mynode;
-
-    for (int node = 0; node < torc_num_nodes(); node++)
-    {
-        if (node != mynode)
-        {
-            //! OK. This descriptor is a stack variable
-            send_descriptor(node, &mydata, DISABLE_INTERNODE_STEALING);
-        }
-    }
 }
 
+/**
+ * @brief Enable inter-node stealing on the calling node
+ * Stealing is on by default (TORC_STEALING)
+ */
 void torc_enable_stealing()
 {
 #if DEBUG
@@ -546,24 +607,6 @@ void torc_enable_stealing()
 #endif
 
     internode_stealing = 1;
-
-    torc_t mydata;
-    memset(&mydata, 0, torc_size);
-
-    int const mynode = torc_node_id();
-
-    mydata.localarg[0] = (INT64)mynode;
-    mydata.homenode = mynode;
-    mydata.sourcenode = mynode;
-
-    for (int node = 0; node < torc_num_nodes(); node++)
-    {
-        if (node != mynode)
-        {
-            //! OK. This descriptor is a stack variable
-            send_descriptor(node, &mydata, ENABLE_INTERNODE_STEALING);
-        }
-    }
 }
 
 /**
@@ -595,8 +638,10 @@ void torc_reset_statistics()
     fflush(0);
 #endif
 
-    torc_t mydata;
-    memset(&mydata, 0, torc_size);
+    torc_ctl_t ctl;
+    memset(&ctl, 0, sizeof(ctl));
+
+    torc_t *mydata = &ctl.desc;
 
     int const mynode = torc_node_id();
 
@@ -605,7 +650,7 @@ void torc_reset_statistics()
         if (node != mynode)
         {
             //!  OK. This descriptor is a stack variable
-            send_descriptor(node, &mydata, RESET_STATISTICS);
+            send_descriptor(node, mydata, RESET_STATISTICS);
         }
         else
         {
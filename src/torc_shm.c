@@ -0,0 +1,356 @@
+/*
+ *  torc_shm.c
+ *  TORC_Lite
+ *
+ *  Created by Panagiotis Hadjidoukas on 1/1/14.
+ *  Copyright 2014 ETH Zurich. All rights reserved.
+ *
+ */
+#include <torc_internal.h>
+#include <torc.h>
+
+/**
+ * \defgroup Shared-memory transport
+ * The nodes of a host exchange their messages (descriptors with their
+ * payloads, batches and stealing replies) through a shared-memory segment
+ * instead of MPI. Every node owns an inbound ring in the segment, where the
+ * threads of the other nodes of the host (and its own) write and its server
+ * thread reads. A message occupies one or more consecutive slots; the ring
+ * is followed by an overflow area, so that a message that wraps around is
+ * still contiguous and is packed in place by the sender.
+ *
+ * Slots are claimed and released with sequence numbers (Vyukov's bounded
+ * queue, extended to runs of slots): slot i is free for position p when its
+ * sequence is p, holds the message at position p when it is p + 1, and the
+ * consumer frees it for position p + TORC_SHM_SLOTS. A message is visible
+ * once the sequence of its first slot is published, after the other ones.
+ *
+ * A message that does not fit in the ring, or that finds the ring full after
+ * a few retries, is sent with MPI. Messages of different threads are not
+ * ordered anyway, so the runtime does not depend on the transport of a message.
+ * TORC_SHM=0 disables the transport.
+ */
+/**@{*/
+
+//! Size of a slot in bytes
+#define TORC_SHM_SLOT 512
+
+//! Slots of a ring (a power of 2)
+#define TORC_SHM_SLOTS 4096
+
+//! Slots of the largest message (the size of the overflow area)
+#define TORC_SHM_MAX_RUN (TORC_SHM_SLOTS / 4)
+
+//! Attempts to find room in a full ring before falling back to MPI
+#define TORC_SHM_RETRIES 4
+
+/**
+ * @brief Inbound ring of a node
+ *
+ */
+typedef struct
+{
+    //! next position to read (server thread only)
+    atomic_long head;
+    char pad1[CACHE_LINE_SIZE - sizeof(atomic_long)];
+    //! next position to claim
+    atomic_long tail;
+    char pad2[CACHE_LINE_SIZE - sizeof(atomic_long)];
+    atomic_long seq[TORC_SHM_SLOTS];
+    //! slots, then the overflow area
+    char data[(TORC_SHM_SLOTS + TORC_SHM_MAX_RUN) * TORC_SHM_SLOT];
+} torc_ring_t;
+
+/**
+ * @brief Header of a message in the ring
+ *
+ */
+typedef struct
+{
+    INT64 len;
+    INT64 nslots;
+} torc_shm_msg_t;
+
+static struct
+{
+    int enabled;
+    MPI_Comm host_comm;
+    MPI_Win win;
+    //! ring of each node, NULL for the nodes of other hosts
+    torc_ring_t **rings;
+    //! ring of this node
+    torc_ring_t *mine;
+} shm;
+
+/**
+ * @brief Create the segment of the host and find the rings of its nodes
+ * Collective over comm_out
+ */
+void _torc_shm_init()
+{
+    shm.enabled = 0;
+
+    char *s = (char *)getenv("TORC_SHM");
+    int val;
+    int const wanted = !((s != 0) && (sscanf(s, "%d", &val) == 1) && (val == 0));
+
+    enter_comm_cs();
+    MPI_Comm_split_type(comm_out, MPI_COMM_TYPE_SHARED, torc_node_id(), MPI_INFO_NULL, &shm.host_comm);
+    leave_comm_cs();
+
+    int nlocal;
+    MPI_Comm_size(shm.host_comm, &nlocal);
+
+    //! all the nodes of the host agree
+    int use = wanted && (nlocal > 1);
+
+    enter_comm_cs();
+    MPI_Allreduce(MPI_IN_PLACE, &use, 1, MPI_INT, MPI_MIN, shm.host_comm);
+    leave_comm_cs();
+
+    if (!use)
+    {
+        enter_comm_cs();
+        MPI_Comm_free(&shm.host_comm);
+        leave_comm_cs();
+        return;
+    }
+
+    torc_ring_t *base;
+
+    enter_comm_cs();
+    MPI_Win_allocate_shared(sizeof(torc_ring_t), 1, MPI_INFO_NULL, shm.host_comm, &base, &shm.win);
+    leave_comm_cs();
+
+    atomic_init(&base->head, 0);
+    atomic_init(&base->tail, 0);
+    for (long i = 0; i < TORC_SHM_SLOTS; i++)
+    {
+        atomic_init(&base->seq[i], i);
+    }
+    shm.mine = base;
+
+    int *nodes = (int *)malloc(nlocal * sizeof(int));
+    int const me = torc_node_id();
+
+    enter_comm_cs();
+    MPI_Allgather(&me, 1, MPI_INT, nodes, 1, MPI_INT, shm.host_comm);
+    leave_comm_cs();
+
+    shm.rings = (torc_ring_t **)calloc(torc_num_nodes(), sizeof(torc_ring_t *));
+    for (int r = 0; r < nlocal; r++)
+    {
+        MPI_Aint size;
+        int disp;
+        void *ptr;
+
+        MPI_Win_shared_query(shm.win, r, &size, &disp, &ptr);
+        shm.rings[nodes[r]] = (torc_ring_t *)ptr;
+    }
+    free(nodes);
+
+    //! the rings are initialized before anyone writes to them
+    enter_comm_cs();
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, shm.win);
+    MPI_Win_sync(shm.win);
+    MPI_Barrier(shm.host_comm);
+    leave_comm_cs();
+
+    shm.enabled = 1;
+
+    if (torc_node_id() == 0)
+    {
+        printf("TORC_LITE ... shared-memory transport between the %d nodes of a host\n", nlocal);
+        fflush(0);
+    }
+}
+
+/**
+ * @brief Release the segment, collective over the nodes of the host
+ *
+ */
+void _torc_shm_end()
+{
+    if (!shm.enabled)
+    {
+        return;
+    }
+
+    shm.enabled = 0;
+
+    MPI_Win_unlock_all(shm.win);
+    MPI_Win_free(&shm.win);
+    MPI_Comm_free(&shm.host_comm);
+
+    free(shm.rings);
+    shm.rings = NULL;
+}
+
+/**
+ * @brief Whether node is reached through the shared-memory segment
+ *
+ */
+int torc_shm_peer(int node)
+{
+    return shm.enabled && (shm.rings[node] != NULL);
+}
+
+/**
+ * @brief Claim room for a message of len bytes in the ring of node
+ *
+ * @param node Rank of destination node
+ * @param len  length of the message
+ * @param pos  set to the position of the message, for torc_shm_commit
+ * @return char* where the message is written, NULL if it must go through MPI
+ */
+char *torc_shm_reserve(int node, size_t len, long *pos)
+{
+    if (!torc_shm_peer(node))
+    {
+        return NULL;
+    }
+
+    long const k = (sizeof(torc_shm_msg_t) + len + TORC_SHM_SLOT - 1) / TORC_SHM_SLOT;
+    if (k > TORC_SHM_MAX_RUN)
+    {
+        return NULL;
+    }
+
+    torc_ring_t *r = shm.rings[node];
+
+    long p = atomic_load_explicit(&r->tail, memory_order_relaxed);
+
+    for (int retries = 0; retries < TORC_SHM_RETRIES;)
+    {
+        int free_run = 1;
+        int moved = 0;
+
+        for (long j = 0; j < k; j++)
+        {
+            long const seq = atomic_load_explicit(&r->seq[(p + j) & (TORC_SHM_SLOTS - 1)], memory_order_acquire);
+            if (seq < p + j)
+            {
+                //! not consumed yet
+                free_run = 0;
+                break;
+            }
+            if (seq > p + j)
+            {
+                //! claimed by another thread
+                moved = 1;
+                break;
+            }
+        }
+
+        if (free_run && !moved)
+        {
+            if (atomic_compare_exchange_weak_explicit(&r->tail, &p, p + k, memory_order_relaxed, memory_order_relaxed))
+            {
+                torc_shm_msg_t *m = (torc_shm_msg_t *)(r->data + (p & (TORC_SHM_SLOTS - 1)) * TORC_SHM_SLOT);
+                m->len = len;
+                m->nslots = k;
+
+                *pos = p;
+                return (char *)(m + 1);
+            }
+            //! p has been reloaded
+            continue;
+        }
+
+        if (moved)
+        {
+            p = atomic_load_explicit(&r->tail, memory_order_relaxed);
+            continue;
+        }
+
+        //! the ring is full: wait for the server thread of node
+        retries++;
+        sched_yield();
+        p = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Publish a message written after torc_shm_reserve
+ *
+ * @param node Rank of destination node
+ * @param pos  position returned by torc_shm_reserve
+ */
+void torc_shm_commit(int node, long pos)
+{
+    torc_ring_t *r = shm.rings[node];
+
+    torc_shm_msg_t *m = (torc_shm_msg_t *)(r->data + (pos & (TORC_SHM_SLOTS - 1)) * TORC_SHM_SLOT);
+    long const k = m->nslots;
+
+    //! the first slot last: the consumer sees the whole message or nothing
+    for (long j = k - 1; j >= 0; j--)
+    {
+        atomic_store_explicit(&r->seq[(pos + j) & (TORC_SHM_SLOTS - 1)], pos + j + 1, memory_order_release);
+    }
+
+    __sync_fetch_and_add(&shm_messages, 1);
+}
+
+/**
+ * @brief Copy a message to the ring of node
+ *
+ * @param node Rank of destination node
+ * @param msg  message
+ * @param len  length of the message
+ * @return int 1 if sent, 0 if it must go through MPI
+ */
+int torc_shm_send(int node, void const *msg, size_t len)
+{
+    long pos;
+    char *out = torc_shm_reserve(node, len, &pos);
+
+    if (out == NULL)
+    {
+        return 0;
+    }
+
+    memcpy(out, msg, len);
+    torc_shm_commit(node, pos);
+
+    return 1;
+}
+
+/**
+ * @brief Take the next message of the ring of this node (server thread only)
+ *
+ * @return torc_t* received descriptor, NULL if the ring is empty
+ */
+torc_t *torc_shm_receive()
+{
+    if (!shm.enabled)
+    {
+        return NULL;
+    }
+
+    torc_ring_t *r = shm.mine;
+
+    long const p = atomic_load_explicit(&r->head, memory_order_relaxed);
+
+    if (atomic_load_explicit(&r->seq[p & (TORC_SHM_SLOTS - 1)], memory_order_acquire) != p + 1)
+    {
+        return NULL;
+    }
+
+    torc_shm_msg_t *m = (torc_shm_msg_t *)(r->data + (p & (TORC_SHM_SLOTS - 1)) * TORC_SHM_SLOT);
+    long const k = m->nslots;
+
+    torc_t *desc = receive_buffered_descriptor((char *)(m + 1), m->len);
+
+    for (long j = 0; j < k; j++)
+    {
+        atomic_store_explicit(&r->seq[(p + j) & (TORC_SHM_SLOTS - 1)], p + j + TORC_SHM_SLOTS, memory_order_release);
+    }
+    atomic_store_explicit(&r->head, p + k, memory_order_relaxed);
+
+    return desc;
+}
+
+/**@}*/
@@ -0,0 +1,550 @@
+/*
+ *  torc_steal.c
+ *  TORC_Lite
+ *
+ *  Created by Panagiotis Hadjidoukas on 1/1/14.
+ *  Copyright 2014 ETH Zurich. All rights reserved.
+ *
+ */
+#include <torc_internal.h>
+#include <torc.h>
+
+/**
+ * \defgroup Victim selection
+ * An idle worker starts a sweep over the other nodes in an order given by
+ * steal_policy (TORC_STEAL_POLICY): sequential, random, hierarchical (nodes of
+ * the same host first) or last-victim (the node of the last successful steal
+ * first). The replies arrive at the server thread, which hands the stolen
+ * tasks to the worker that asked for work and keeps the sweep going.
+ *
+ * Stealing throttles itself instead of being switched off:
+ * - a victim that had no work is skipped for an exponentially growing time;
+ * - the number of outstanding requests (at most steal_window) follows the
+ *   recent success rate of the node;
+ * - every message carries a hint of whether its sender has ready tasks
+ *   (work_hint), which clears the back-off of the sender and lets an idle
+ *   node ask it for work at once.
+ *
+ * With TORC_STEAL_RMA=1 no requests are sent: the idle worker visits the
+ * stealing windows of the victims in the same order and with the same
+ * back-off (see torc_rma.c).
+ */
+/**@{*/
+
+//! First back-off of a victim without work (usecs)
+#define TORC_STEAL_BACKOFF_MIN 100
+
+//! Longest back-off (usecs)
+#define TORC_STEAL_BACKOFF_MAX 100000
+
+//! Weight of the last reply in the success rate
+#define TORC_STEAL_RATE_WEIGHT 0.125
+
+/**
+ * @brief Stealing state of the node
+ *
+ */
+static struct
+{
+    //! protects the state, workers only try to lock it
+    pthread_mutex_t m;
+    unsigned int seed;
+    //! the current sweep
+    int victims[MAX_NODES];
+    int nvictims;
+    int next;
+    //! outstanding requests
+    int inflight;
+    char pending[MAX_NODES];
+    double sent[MAX_NODES];
+    //! failed requests in a row and back-off of each victim
+    int failures[MAX_NODES];
+    double retry[MAX_NODES];
+    //! node of the last successful steal, -1 if none
+    int last_victim;
+    //! moving average of the replies that carried work
+    double rate;
+    //! all the victims back off until this time
+    double next_try;
+} steal = {PTHREAD_MUTEX_INITIALIZER};
+
+static char const *policy_names[] = {"sequential", "random", "hierarchical", "last"};
+
+/**
+ * @brief Parse the name (or the number) of a victim selection policy
+ *
+ * @param s name
+ * @return int policy, -1 if unknown
+ */
+int _torc_steal_policy(char const *s)
+{
+    int val;
+    if (sscanf(s, "%d", &val) == 1)
+    {
+        return ((val >= TORC_STEAL_SEQUENTIAL) && (val <= TORC_STEAL_LAST_VICTIM)) ? val : -1;
+    }
+
+    for (int p = TORC_STEAL_SEQUENTIAL; p <= TORC_STEAL_LAST_VICTIM; p++)
+    {
+        if (strcmp(s, policy_names[p]) == 0)
+        {
+            return p;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Find the nodes that share a host with each node
+ * Collective over comm_out
+ */
+void _torc_steal_init()
+{
+    MPI_Comm host_comm;
+    int host = torc_node_id();
+
+    enter_comm_cs();
+    MPI_Comm_split_type(comm_out, MPI_COMM_TYPE_SHARED, torc_node_id(), MPI_INFO_NULL, &host_comm);
+    //! a host is named after its lowest node
+    MPI_Bcast(&host, 1, MPI_INT, 0, host_comm);
+    MPI_Comm_free(&host_comm);
+    leave_comm_cs();
+
+    int *hosts = (int *)malloc(torc_num_nodes() * sizeof(int));
+
+    enter_comm_cs();
+    MPI_Allgather(&host, 1, MPI_INT, hosts, 1, MPI_INT, comm_out);
+    leave_comm_cs();
+
+    for (int i = 0; i < torc_num_nodes(); i++)
+    {
+        node_info[i].host = hosts[i];
+    }
+
+    free(hosts);
+
+    steal.seed = 1 + torc_node_id();
+    steal.nvictims = 0;
+    steal.next = 0;
+    steal.inflight = 0;
+    steal.last_victim = -1;
+    steal.rate = 1.0;
+    steal.next_try = 0;
+
+    if ((torc_node_id() == 0) && (torc_num_nodes() > 1))
+    {
+        printf("TORC_LITE ... inter-node stealing policy: %s\n", policy_names[steal_policy]);
+        fflush(0);
+    }
+}
+
+/**
+ * @brief Shuffle n victims (Fisher-Yates)
+ *
+ */
+static void shuffle(int *victims, int n, unsigned int *seed)
+{
+    for (int i = n - 1; i > 0; i--)
+    {
+        int const j = rand_r(seed) % (i + 1);
+        int const t = victims[i];
+        victims[i] = victims[j];
+        victims[j] = t;
+    }
+}
+
+/**
+ * @brief The order in which the node visits the other nodes
+ *
+ * @param victims nodes to visit
+ * @return int number of victims
+ */
+static int victim_order(int *victims)
+{
+    int const self_node = torc_node_id();
+    int const nnodes = torc_num_nodes();
+
+    int n = 0;
+
+    switch (steal_policy)
+    {
+    case TORC_STEAL_SEQUENTIAL:
+    {
+        for (int k = 1; k < nnodes; k++)
+        {
+            victims[n++] = (self_node + k) % nnodes;
+        }
+    }
+    break;
+
+    case TORC_STEAL_HIERARCHICAL:
+    {
+        int const host = node_info[self_node].host;
+
+        //! same host first, then the rest, each in random order
+        for (int node = 0; node < nnodes; node++)
+        {
+            if ((node != self_node) && (node_info[node].host == host))
+            {
+                victims[n++] = node;
+            }
+        }
+        shuffle(victims, n, &steal.seed);
+
+        int const local = n;
+        for (int node = 0; node < nnodes; node++)
+        {
+            if (node_info[node].host != host)
+            {
+                victims[n++] = node;
+            }
+        }
+        shuffle(victims + local, n - local, &steal.seed);
+    }
+    break;
+
+    case TORC_STEAL_LAST_VICTIM:
+    {
+        if (steal.last_victim >= 0)
+        {
+            victims[n++] = steal.last_victim;
+        }
+
+        for (int node = 0; node < nnodes; node++)
+        {
+            if ((node != self_node) && (node != steal.last_victim))
+            {
+                victims[n++] = node;
+            }
+        }
+
+        int const first = (steal.last_victim >= 0);
+        shuffle(victims + first, n - first, &steal.seed);
+    }
+    break;
+
+    //! TORC_STEAL_RANDOM
+    default:
+    {
+        for (int node = 0; node < nnodes; node++)
+        {
+            if (node != self_node)
+            {
+                victims[n++] = node;
+            }
+        }
+        shuffle(victims, n, &steal.seed);
+    }
+    break;
+    }
+
+    return n;
+}
+
+/**
+ * @brief Back off from a victim that had no work
+ * The caller holds steal.m
+ *
+ * @param victim node
+ * @param now    current time
+ */
+static void steal_backoff(int victim, double now)
+{
+    int const f = (steal.failures[victim] < 10) ? steal.failures[victim] : 10;
+    int backoff = TORC_STEAL_BACKOFF_MIN << f;
+    if (backoff > TORC_STEAL_BACKOFF_MAX)
+    {
+        backoff = TORC_STEAL_BACKOFF_MAX;
+    }
+
+    steal.failures[victim]++;
+    steal.retry[victim] = now + backoff * 1.0E-6;
+}
+
+/**
+ * @brief Account for the outcome of a stealing attempt
+ * The caller holds steal.m
+ *
+ * @param victim  node
+ * @param n       number of stolen tasks
+ * @param now     current time
+ * @param latency duration of the attempt
+ */
+static void steal_record(int victim, int n, double now, double latency)
+{
+    steal_requests++;
+    steal_latency += latency;
+    if (latency > steal_latency_max)
+    {
+        steal_latency_max = latency;
+    }
+    steal_hits += n;
+
+    steal.rate = (1.0 - TORC_STEAL_RATE_WEIGHT) * steal.rate + TORC_STEAL_RATE_WEIGHT * (n > 0);
+
+    if (n > 0)
+    {
+        //! the sweep ends here
+        steal.next = steal.nvictims;
+        steal.last_victim = victim;
+        steal.failures[victim] = 0;
+        steal.retry[victim] = 0;
+    }
+    else
+    {
+        steal_backoff(victim, now);
+    }
+}
+
+/**
+ * @brief Without outstanding requests, nothing is tried before the first back-off expires
+ * The caller holds steal.m
+ *
+ */
+static void steal_next_try(double now)
+{
+    steal.next_try = 0;
+    if (steal.inflight == 0)
+    {
+        steal.next_try = now + TORC_STEAL_BACKOFF_MAX * 1.0E-6;
+        for (int node = 0; node < torc_num_nodes(); node++)
+        {
+            if ((node != torc_node_id()) && (steal.retry[node] < steal.next_try))
+            {
+                steal.next_try = steal.retry[node];
+            }
+        }
+    }
+}
+
+/**
+ * @brief Send stealing requests to the victims that do not back off
+ * The caller holds steal.m
+ *
+ * @param vp worker that asks for work, MAX_NVPS for the server thread
+ */
+static void steal_issue(int vp)
+{
+    if (appl_finished || termination_flag)
+    {
+        return;
+    }
+
+    double const now = torc_gettime();
+
+    //! 1 outstanding request when stealing keeps failing, steal_window when it succeeds
+    int const window = 1 + (int)((steal_window - 1) * steal.rate + 0.5);
+
+    int restarted = 0;
+    while (steal.inflight < window)
+    {
+        if (steal.next >= steal.nvictims)
+        {
+            //! a whole sweep without a victim to ask
+            if (restarted)
+            {
+                break;
+            }
+            steal.nvictims = victim_order(steal.victims);
+            steal.next = 0;
+            restarted = 1;
+        }
+
+        int const victim = steal.victims[steal.next++];
+        if (steal.pending[victim] || (steal.retry[victim] > now))
+        {
+            continue;
+        }
+
+        //! the reply names the worker that asked for work
+        torc_t *request = _torc_get_reused_desc(2);
+        request->narg = 2;
+        request->arg[0].localarg = torc_node_id();
+        request->arg[1].localarg = vp;
+        request->homenode = torc_node_id();
+
+        steal.pending[victim] = 1;
+        steal.sent[victim] = now;
+        steal.inflight++;
+
+        post_descriptor(victim, request, TORC_STEAL_REQUEST);
+    }
+
+    steal_next_try(now);
+}
+
+/**
+ * @brief Take tasks from the stealing windows of the victims that do not back off
+ * At most steal_window victims are visited, the first one with tasks ends the sweep
+ * The caller holds steal.m
+ *
+ * @param vp worker that asks for work, MAX_NVPS for other threads
+ */
+static void steal_windows(int vp)
+{
+    if (appl_finished || termination_flag)
+    {
+        return;
+    }
+
+    double now = torc_gettime();
+
+    int visited = 0;
+    int restarted = 0;
+    while (visited < steal_window)
+    {
+        if (steal.next >= steal.nvictims)
+        {
+            if (restarted)
+            {
+                break;
+            }
+            steal.nvictims = victim_order(steal.victims);
+            steal.next = 0;
+            restarted = 1;
+        }
+
+        int const victim = steal.victims[steal.next++];
+        if (steal.retry[victim] > now)
+        {
+            continue;
+        }
+
+        int const n = _torc_rma_steal(victim, vp);
+
+        double const then = now;
+        now = torc_gettime();
+        steal_record(victim, n, now, now - then);
+
+        visited++;
+        if (n > 0)
+        {
+            break;
+        }
+    }
+
+    steal_next_try(now);
+}
+
+/**
+ * @brief Ask the other nodes for work on behalf of the calling worker
+ * The call does not wait for the replies
+ *
+ */
+void _torc_steal()
+{
+    if ((torc_num_nodes() == 1) || (steal.inflight >= steal_window))
+    {
+        return;
+    }
+
+    if ((steal.inflight == 0) && (steal.next_try > 0) && (torc_gettime() < steal.next_try))
+    {
+        return;
+    }
+
+    if (pthread_mutex_trylock(&steal.m) != 0)
+    {
+        return;
+    }
+
+    int const vp = _torc_get_vpid();
+    if (steal_rma)
+    {
+        steal_windows((vp >= 0) ? vp : MAX_NVPS);
+    }
+    else
+    {
+        steal_issue((vp >= 0) ? vp : MAX_NVPS);
+    }
+
+    pthread_mutex_unlock(&steal.m);
+}
+
+/**
+ * @brief Accept the reply to a stealing request (server thread)
+ * The first task goes to the local queue of the worker that asked for work,
+ * the rest to the public queues
+ *
+ * @param reply TORC_STEAL_REPLY batch
+ */
+void _torc_steal_reply(torc_t *reply)
+{
+    int const victim = reply->sourcenode;
+    int const vp = reply->target_queue;
+
+    int n = 0;
+
+    char *cursor = NULL;
+
+    torc_t *entry;
+    while ((entry = unpack_batch(reply, &cursor)) != NULL)
+    {
+        //! homenode == torc_node_id() -> the descriptor is stolen by its owner node
+        if (entry->homenode != torc_node_id())
+        {
+            unpack_arguments(entry);
+        }
+        entry->next = NULL;
+
+        if ((n == 0) && (vp >= 0) && (vp < (int)kthreads))
+        {
+            torc_to_i_lrq_end(vp, entry);
+        }
+        else
+        {
+            torc_to_i_rq_end(entry);
+        }
+        n++;
+    }
+
+    free(reply->payload);
+    reply->payload = NULL;
+
+    pthread_mutex_lock(&steal.m);
+
+    double const now = torc_gettime();
+
+    steal.pending[victim] = 0;
+    steal.inflight--;
+    steal_record(victim, n, now, now - steal.sent[victim]);
+
+    if ((n == 0) && internode_stealing && !torc_i_rq_available())
+    {
+        //! the node is still idle, go on with the sweep
+        steal_issue(vp);
+    }
+
+    pthread_mutex_unlock(&steal.m);
+}
+
+/**
+ * @brief Piggybacked hint of a received message (server thread)
+ * A node that has work again is asked at once by an idle node
+ *
+ * @param node sender of the message
+ * @param hint the sender had ready tasks
+ */
+void _torc_steal_hint(int node, int hint)
+{
+    if (!hint || (node == torc_node_id()) || (steal.retry[node] == 0))
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&steal.m);
+
+    steal.failures[node] = 0;
+    steal.retry[node] = 0;
+    steal.next_try = 0;
+
+    if (internode_stealing && !steal_rma && !steal.pending[node] && !torc_i_rq_available())
+    {
+        steal_issue(MAX_NVPS);
+    }
+
+    pthread_mutex_unlock(&steal.m);
+}
+
+/**@}*/
@@ -21,6 +21,37 @@ pthread_mutex_t created_workers_m = PTHREAD_MUTEX_INITIALIZER;
 //! Active workers mutex
 pthread_mutex_t active_workers_m = PTHREAD_MUTEX_INITIALIZER;
 
+/**
+ * @brief Idle state of a worker
+ * An idle worker spins, then yields and finally parks on its condition variable
+ *
+ */
+typedef union _torc_park {
+    struct
+    {
+        pthread_mutex_t m;
+        pthread_cond_t c;
+        //! the worker waits (or is about to wait) on c
+        atomic_int parked;
+        //! a wake-up is pending, the next park returns immediately
+        atomic_int signalled;
+        //! consecutive idle rounds
+        unsigned int rounds;
+    } p;
+    char pad[2 * CACHE_LINE_SIZE];
+} torc_park_t;
+
+static torc_park_t park[MAX_NVPS];
+
+//! Number of parked workers
+static atomic_int nparked = 0;
+
+//! Idle rounds spent spinning before the worker starts yielding
+#define TORC_IDLE_SPINS 64
+
+//! Idle rounds spent yielding before the worker parks
+#define TORC_IDLE_YIELDS 16
+
 /**
  * @brief Create a new worker
  * 
@@ -37,8 +68,8 @@ void *_torc_worker(void *arg)
     torc_t *desc = (torc_t *)calloc(1, torc_size);
 
     desc->vp_id = vp_id;
-
-    _lock_init(&desc->lock);
+    //! not pooled, it lives as long as the worker
+    desc->sclass = -1;
 
     desc->work = (func_t)_torc_scheduler_loop;
 
@@ -57,6 +88,12 @@ void *_torc_worker(void *arg)
 
     _torc_set_vpid(vp_id);
 
+    //! the worker is pinned from its creation, its queues follow it
+    if (_torc_affinity_pinned())
+    {
+        rq_localize(vp_id);
+    }
+
     _torc_set_currt(desc);
 
     int repeat;
@@ -110,6 +147,7 @@ void start_worker(long id)
         pthread_attr_init(&attr);
         pthread_attr_setscope(&attr, PTHREAD_SCOPE_SYSTEM);
         pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        _torc_affinity_attr(&attr, id);
     }
 
     int res = pthread_create(&pth, &attr, _torc_worker, (void *)id);
@@ -133,6 +171,15 @@ void _torc_md_init()
     pthread_key_create(&vp_key, NULL);
     pthread_key_create(&currt_key, NULL);
 
+    for (unsigned int i = 0; i < kthreads; i++)
+    {
+        pthread_mutex_init(&park[i].p.m, NULL);
+        pthread_cond_init(&park[i].p.c, NULL);
+    }
+
+    //! pins the main thread (worker 0), the other threads are pinned when created
+    _torc_affinity_init();
+
     if (torc_num_nodes() > 1)
     {
         start_server_thread();
@@ -153,10 +200,10 @@ void _torc_md_init()
  */
 void _torc_md_end()
 {
-    unsigned int my_vp = _torc_get_vpid();
+    long const my_vp = _torc_get_vpid();
 
 #if DEBUG
-    printf("worker_thread %ud exits\n", my_vp);
+    printf("worker_thread %ld exits\n", my_vp);
     fflush(0);
 #endif
 
@@ -200,6 +247,9 @@ void _torc_md_end()
         _torc_stats();
 
         MPI_Barrier(comm_out);
+        _torc_shm_end();
+        _torc_rma_end();
+        _torc_group_end();
         MPI_Finalize();
         exit(0);
     }
@@ -221,6 +271,176 @@ void thread_sleep(int ms)
     nanosleep(&req, &rem);
 }
 
+/**
+ * @brief Park the worker vp until it is woken up or the yield time elapses
+ *
+ * @param vp Virtual processor ID
+ */
+static void _torc_park(int vp)
+{
+    torc_park_t *pk = &park[vp];
+
+    atomic_store(&pk->p.parked, 1);
+    atomic_fetch_add(&nparked, 1);
+
+    //! pairs with the fences of _torc_wake_one and _torc_wake_vp: either the waker
+    //! sees this worker parked or the worker sees the new work (or the pending wake-up)
+    atomic_thread_fence(memory_order_seq_cst);
+
+    //! a wake-up is consumed by the park that it ends or skips, so one that
+    //! arrives while the worker is leaving is kept for its next park
+    if (!atomic_exchange(&pk->p.signalled, 0) && !torc_i_rq_available() && !appl_finished)
+    {
+        struct timeval now;
+        struct timespec deadline;
+
+        gettimeofday(&now, NULL);
+        long nsec = now.tv_usec * 1000L + (yieldtime % 1000) * 1000000L;
+        deadline.tv_sec = now.tv_sec + yieldtime / 1000 + nsec / 1000000000L;
+        deadline.tv_nsec = nsec % 1000000000L;
+
+        pthread_mutex_lock(&pk->p.m);
+        while (!appl_finished && !atomic_exchange(&pk->p.signalled, 0))
+        {
+            if (pthread_cond_timedwait(&pk->p.c, &pk->p.m, &deadline) == ETIMEDOUT)
+            {
+                break;
+            }
+        }
+        pthread_mutex_unlock(&pk->p.m);
+    }
+
+    atomic_fetch_sub(&nparked, 1);
+    atomic_store(&pk->p.parked, 0);
+}
+
+/**
+ * @brief One idle round of the worker vp: spin, then yield, then park
+ *
+ * @param vp Virtual processor ID
+ */
+void _torc_idle(int vp)
+{
+    if ((vp < 0) || (vp >= (int)kthreads))
+    {
+        sched_yield();
+        return;
+    }
+
+    unsigned int const rounds = park[vp].p.rounds++;
+
+    if (rounds < TORC_IDLE_SPINS)
+    {
+        for (volatile int i = 0; i < 100; i++)
+            ;
+    }
+    else if (rounds < TORC_IDLE_SPINS + TORC_IDLE_YIELDS)
+    {
+        sched_yield();
+    }
+    else
+    {
+        _torc_park(vp);
+    }
+}
+
+/**
+ * @brief The worker vp found work, restart its spin phase
+ *
+ * @param vp Virtual processor ID
+ */
+void _torc_idle_reset(int vp)
+{
+    if ((vp >= 0) && (vp < (int)kthreads))
+    {
+        park[vp].p.rounds = 0;
+    }
+}
+
+/**
+ * @brief Signal the worker vp under its mutex
+ *
+ * @param vp Virtual processor ID
+ */
+static void _torc_unpark(int vp)
+{
+    torc_park_t *pk = &park[vp];
+
+    pthread_mutex_lock(&pk->p.m);
+    atomic_store(&pk->p.signalled, 1);
+    pthread_cond_signal(&pk->p.c);
+    pthread_mutex_unlock(&pk->p.m);
+}
+
+/**
+ * @brief Wake up one parked worker, if any
+ * Called after new work has been enqueued
+ *
+ */
+void _torc_wake_one()
+{
+    atomic_thread_fence(memory_order_seq_cst);
+
+    if (atomic_load_explicit(&nparked, memory_order_relaxed) == 0)
+    {
+        return;
+    }
+
+    static atomic_uint next = 0;
+
+    unsigned int const start = atomic_fetch_add_explicit(&next, 1, memory_order_relaxed);
+
+    for (unsigned int k = 0; k < kthreads; k++)
+    {
+        int const vp = (start + k) % kthreads;
+
+        int expected = 0;
+        if (atomic_load(&park[vp].p.parked) && atomic_compare_exchange_strong(&park[vp].p.signalled, &expected, 1))
+        {
+            _torc_unpark(vp);
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Wake up the worker vp
+ * If vp is not parked, its next attempt to park returns immediately
+ *
+ * @param vp Virtual processor ID
+ * @return int 1 if the worker was parked
+ */
+int _torc_wake_vp(int vp)
+{
+    if ((vp < 0) || (vp >= (int)kthreads))
+    {
+        return 0;
+    }
+
+    atomic_store(&park[vp].p.signalled, 1);
+    atomic_thread_fence(memory_order_seq_cst);
+
+    if (atomic_load(&park[vp].p.parked))
+    {
+        _torc_unpark(vp);
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Wake up all the parked workers (e.g. at termination)
+ *
+ */
+void _torc_wake_all()
+{
+    for (unsigned int vp = 0; vp < kthreads; vp++)
+    {
+        _torc_unpark(vp);
+    }
+}
+
 /**
  * @brief Set the TORC descriptor bound to the vp_key on behalf of the calling thread 
  * 
@@ -228,17 +448,18 @@ void thread_sleep(int ms)
  */
 void _torc_set_vpid(long vp)
 {
-    pthread_setspecific(vp_key, (void *)vp);
+    //! Shifted by one so that threads without a virtual processor read back -1
+    pthread_setspecific(vp_key, (void *)(vp + 1));
 }
 
 /**
  * @brief Get the virtual processor ID which is the value currently bound to the vp_key on behalf of the calling thread
  * 
- * @return long 
+ * @return long the virtual processor ID or -1 for threads that are not workers (e.g. the server thread)
  */
 long _torc_get_vpid()
 {
-    return (long)pthread_getspecific(vp_key);
+    return (long)pthread_getspecific(vp_key) - 1;
 }
 
 /**